@@ -15,6 +15,8 @@
 //--------------------------------------------------------------------------------------------------
 //#define TEMP_ENABLED  /**< this line must be commented out if the temperature sensor is not present */
 //#define RF_PRESENT  /**< this line must be commented out if the RFM12B module is not present */
+//#define OLED_PRESENT  /**< uncomment if an OLED display is used (set by the 'oled' environment of platformio.ini) */
+//#define DISPLAY_TIMER_ENABLED  /**< uncomment to multiplex the 7-segments display from a Timer2 interrupt instead of loop() */
 
 // Output messages
 //#define EMONESP  /**< Uncomment if an ESP WiFi module is used
@@ -30,6 +32,8 @@
 
 #include "utils_dualtariff.h"
 #include "utils_relay.h"
+#include "utils_rf.h"
+#include "utils_schedule.h"
 #include "utils_temp.h"
 
 inline constexpr uint8_t NO_OF_DUMPLOADS{ 2 }; /**< number of dump loads connected to the diverter */
@@ -49,10 +53,21 @@ inline constexpr bool OVERRIDE_PIN_PRESENT{ false };                    /**< set
 inline constexpr bool WATCHDOG_PIN_PRESENT{ false }; /**< set it to 'true' if there's a watch led */
 inline constexpr bool RELAY_DIVERSION{ false };      /**< set it to 'true' if a relay is used for diversion */
 inline constexpr bool DUAL_TARIFF{ false };          /**< set it to 'true' if there's a dual tariff each day AND the router is connected to the billing meter */
+inline constexpr bool TRACE_CAPTURE{ false };        /**< set it to 'true' to record per-cycle traces, dumped to the Serial output on trigger (diagnostics) */
 
 inline constexpr bool OLD_PCB{ true }; /**< set it to 'true' if the old PCB is used */
 
-inline constexpr DisplayType TYPE_OF_DISPLAY{ DisplayType::SEG }; /**< set it to installed display including optional additional logic chips */
+#ifdef OLED_PRESENT
+inline constexpr DisplayType TYPE_OF_DISPLAY{ DisplayType::OLED }; /**< managed through OLED_PRESENT */
+#else
+inline constexpr DisplayType TYPE_OF_DISPLAY{ DisplayType::SEG }; /**< set it to installed display including optional additional logic chips (OLED: see OLED_PRESENT) */
+#endif
+
+#ifdef DISPLAY_TIMER_ENABLED
+inline constexpr bool DISPLAY_TIMER_DRIVEN{ true }; /**< managed through DISPLAY_TIMER_ENABLED */
+#else
+inline constexpr bool DISPLAY_TIMER_DRIVEN{ false }; /**< managed through DISPLAY_TIMER_ENABLED */
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////////////
 // allocation of digital pins which are not dependent on the display type that is in use
@@ -67,6 +82,7 @@ inline constexpr uint8_t diversionPin{ 0xff };  /**< if LOW, set diversion on st
 inline constexpr uint8_t rotationPin{ 0xff };   /**< if LOW, trigger a load priority rotation */
 inline constexpr uint8_t forcePin{ 0xff };      /**< for 3-phase PCB, force pin */
 inline constexpr uint8_t watchDogPin{ 0xff };   /**< watch dog LED */
+inline constexpr uint8_t oledPagePin{ 0xff };   /**< if LOW, switch to the next page of the OLED display */
 
 inline constexpr RelayEngine relays{ { { 0xff, 1000, 200, 1, 1 } } }; /**< config for relay diversion, see class definition for defaults and advanced options */
 
@@ -75,12 +91,30 @@ inline constexpr RelayEngine relays{ { { 0xff, 1000, 200, 1, 1 } } }; /**< confi
 inline constexpr uint8_t ul_OFF_PEAK_DURATION{ 8 };                        /**< Duration of the off-peak period in hours */
 inline constexpr pairForceLoad rg_ForceLoad[NO_OF_DUMPLOADS]{ { -3, 2 } }; /**< force config for load #1 ONLY for dual tariff */
 
+inline constexpr auto forceSchedule PROGMEM{ makeSchedule< ul_OFF_PEAK_DURATION >(rg_ForceLoad) }; /**< force windows: rg_ForceLoad, then additional off-peak/time windows (see utils_schedule.h) */
+inline constexpr LoadEnergyTarget loadEnergyTargets[NO_OF_DUMPLOADS]{}; /**< daily energy target of each load, e.g. { 6000, 2500 } for 6 kWh with a 2500 W element */
+
 ////////////////////////////////////////////////////////////////////////////////////////
 // Temperature sensor configuration
 inline constexpr int16_t iTemperatureThreshold{ 100 }; /**< the temperature threshold to stop overriding in °C */
 inline constexpr TemperatureSensing temperatureSensing{ 0xff,
                                                         { { 0x28, 0x1B, 0xD7, 0x6A, 0x09, 0x00, 0x00, 0xB7 } } }; /**< list of temperature sensor Addresses */
 
+inline constexpr LoadTemperatureLimit loadTemperatureLimits[NO_OF_DUMPLOADS]{}; /**< temperature limit of each load, e.g. { 0, 60 } for 60°C on sensor T1 */
+inline constexpr uint8_t TEMPERATURE_DERATING_BAND{ 5 };                         /**< width of the derating band below each limit in °C */
+inline constexpr uint8_t DERATING_WINDOW_IN_SECONDS{ 10 };                       /**< a derated load gets its share of diversion within this window */
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Trace capture configuration (diagnostics)
+inline constexpr int16_t TRACE_IMPORT_SPIKE_IN_WATTS{ 1000 }; /**< triggers when the import during one mains cycle is above this value */
+inline constexpr uint8_t TRACE_TOGGLE_STORM{ 10 };            /**< triggers when the loads toggle this many times within one second */
+
+////////////////////////////////////////////////////////////////////////////////////////
+// RF configuration (RFM12B)
+using PayloadTx = PayloadTx_struct< TEMP_SENSOR_PRESENT ? temperatureSensing.get_size() : 0 >; /**< datalog payload, also sent by the RF module */
+
+inline constexpr RFTransmitter< PayloadTx > rf{ RFBands::RF_868MHZ, 10, 210 }; /**< config for the RF module: frequency band, node ID, network group */
+
 inline constexpr uint32_t ROTATION_AFTER_CYCLES{ 8UL * 3600UL * SUPPLY_FREQUENCY }; /**< rotates load priorities after this period of inactivity */
 
 #endif /* CONFIG_H */
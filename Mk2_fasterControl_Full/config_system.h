@@ -19,6 +19,10 @@
 // Physical constants, please do not change!
 inline constexpr uint16_t SECONDS_PER_MINUTE{ 60 };
 inline constexpr uint16_t MINUTES_PER_HOUR{ 60 };
+inline constexpr uint8_t HOURS_PER_DAY{ 24 };
+inline constexpr uint8_t DAYS_PER_WEEK{ 7 };
+inline constexpr uint16_t MINUTES_PER_DAY{ HOURS_PER_DAY * MINUTES_PER_HOUR };
+inline constexpr uint32_t SECONDS_PER_DAY{ static_cast< uint32_t >(MINUTES_PER_DAY) * SECONDS_PER_MINUTE };
 inline constexpr uint16_t JOULES_PER_WATT_HOUR{ 3600 };  //  (0.001 kWh = 3600 Joules)
 
 // Change these values to suit the local mains frequency and supply meter
@@ -36,6 +40,10 @@ inline constexpr uint8_t DATALOG_PERIOD_IN_SECONDS{ 5 }; /**< Period of datalogg
 inline constexpr typename conditional< DATALOG_PERIOD_IN_SECONDS * SUPPLY_FREQUENCY >= UINT8_MAX, uint16_t, uint8_t >::type
   DATALOG_PERIOD_IN_MAINS_CYCLES{ DATALOG_PERIOD_IN_SECONDS * SUPPLY_FREQUENCY }; /**< Period of datalogging in cycles */
 
+inline constexpr uint8_t STREAM_PERIOD_IN_MAINS_CYCLES{ 0 }; /**< Period of the streaming datalog in cycles (e.g. 5 = 100 ms at 50 Hz), 0 to disable it */
+
+inline constexpr uint32_t SERIAL_BAUD_RATE{ 9600 }; /**< Baud rate of the Serial output, must be 9600 with EmonESP */
+
 // Computes inverse value at compile time to use '*' instead of '/'
 inline constexpr float invSUPPLY_FREQUENCY{ 1.0F / SUPPLY_FREQUENCY };
 inline constexpr float invDATALOG_PERIOD_IN_MAINS_CYCLES{ 1.0F / DATALOG_PERIOD_IN_MAINS_CYCLES };
@@ -13,55 +13,121 @@
 #define DUALTARIFF_H
 
 #include "config.h"
+#include "processing.h"
 
 /**
- * @brief Template class for Load-Overriding
- * @details The array is initialized at compile time so it can be read-only and
- *          the performance and code size are better
+ * @brief Boost of the loads towards their daily energy target
+ * @details The energy diverted to the loads is measured with the diverted CT, and shared between the loads
+ *          according to their number of mains cycles ON (copyOf_countLoadON) during each datalog period.
+ *          A load is forced when the time left in the off-peak period is just enough to deliver its missing
+ *          energy at its rated power, and until the target is reached or the period ends.
+ *          The daily energies are cleared at the end of the off-peak period.
+ *          All members are static: there's only one boost.
  *
- * @tparam N # of loads
- * @tparam D
- * 
  * @ingroup DualTariff
  */
-template< uint8_t N, uint8_t OffPeakDuration = 8 >
-class _rg_OffsetForce
+class EnergyTargetBoost
 {
 public:
-  constexpr _rg_OffsetForce()
+  /**
+   * @brief Add the energy of the last datalog period
+   *
+   * @param powerDiverted The average diverted power over the datalog period in W
+   */
+  static void addDatalogPeriod(int16_t powerDiverted)
   {
-    constexpr uint16_t uiPeakDurationInSec{ OffPeakDuration * 3600 };
-    // calculates offsets for force start and stop of each load
-    for (uint8_t i = 0; i != N; ++i)
+    if (powerDiverted <= 0)
     {
-      const bool bOffsetInMinutes{ rg_ForceLoad[i].getStartOffset() > 24 || rg_ForceLoad[i].getStartOffset() < -24 };
-      const bool bDurationInMinutes{ rg_ForceLoad[i].getDuration() > 24 && UINT16_MAX != rg_ForceLoad[i].getDuration() };
+      return;
+    }
+
+    uint16_t totalCount{ 0 };
+    for (uint8_t i = 0; i < NO_OF_DUMPLOADS; ++i)
+    {
+      totalCount += copyOf_countLoadON[i];
+    }
+    if (!totalCount)
+    {
+      return;
+    }
+
+    const uint32_t energy_J{ static_cast< uint32_t >(powerDiverted) * DATALOG_PERIOD_IN_SECONDS };
+    for (uint8_t i = 0; i < NO_OF_DUMPLOADS; ++i)
+    {
+      dailyEnergy_J[i] += energy_J * copyOf_countLoadON[i] / totalCount;
+    }
+  }
+
+  /**
+   * @brief Decide which loads have to be forced, to be called once per second
+   *
+   * @param offPeak true during the off-peak period
+   * @param now The uptime in seconds
+   * @return uint8_t The forced loads, bit i for load i
+   */
+  static uint8_t proceed(bool offPeak, uint32_t now)
+  {
+    if (!offPeak)
+    {
+      if (inOffPeak)
+      {
+        // a new day starts
+        inOffPeak = false;
+        boostedLoads = 0;
+        for (auto &energy : dailyEnergy_J)
+        {
+          energy = 0;
+        }
+      }
+      return 0;
+    }
 
-      _rg[i][0] = ((rg_ForceLoad[i].getStartOffset() >= 0) ? 0 : uiPeakDurationInSec) + rg_ForceLoad[i].getStartOffset() * (bOffsetInMinutes ? 60ul : 3600ul);
-      _rg[i][0] *= 1000ul;  // convert in milli-seconds
+    if (!inOffPeak)
+    {
+      inOffPeak = true;
+      offPeakStart = now;
+    }
+
+    const uint32_t elapsed{ now - offPeakStart };
+    const uint32_t timeLeft{ elapsed < OFF_PEAK_DURATION_IN_SECONDS ? OFF_PEAK_DURATION_IN_SECONDS - elapsed : 0 };
+
+    for (uint8_t i = 0; i < NO_OF_DUMPLOADS; ++i)
+    {
+      const uint32_t target_J{ static_cast< uint32_t >(loadEnergyTargets[i].target_Wh) * JOULES_PER_WATT_HOUR };
 
-      if (UINT8_MAX == rg_ForceLoad[i].getDuration())
+      if (dailyEnergy_J[i] >= target_J)
       {
-        _rg[i][1] = rg_ForceLoad[i].getDuration();
+        bit_clear(boostedLoads, i);
       }
-      else
+      else if ((target_J - dailyEnergy_J[i]) / loadEnergyTargets[i].ratedPower_W >= timeLeft)
       {
-        _rg[i][1] = _rg[i][0] + rg_ForceLoad[i].getDuration() * (bDurationInMinutes ? 60ul : 3600ul) * 1000ul;
+        bit_set(boostedLoads, i);
       }
     }
+    return boostedLoads;
   }
-  const auto(&operator[](uint8_t i) const)
+
+  /**
+   * @brief Energy received by a load since the end of the last off-peak period
+   *
+   * @param idx The load (0-based)
+   * @return uint16_t The energy in Wh
+   */
+  static uint16_t get_dailyEnergy_Wh(uint8_t idx)
   {
-    return _rg[i];
+    return dailyEnergy_J[idx] / JOULES_PER_WATT_HOUR;
   }
 
 private:
-  uint32_t _rg[N][2]{};
-};
+  static constexpr uint32_t OFF_PEAK_DURATION_IN_SECONDS{ static_cast< uint32_t >(ul_OFF_PEAK_DURATION) * MINUTES_PER_HOUR * SECONDS_PER_MINUTE };
 
-inline uint32_t ul_TimeOffPeak; /**< 'timestamp' for start of off-peak period */
+  static inline uint32_t dailyEnergy_J[NO_OF_DUMPLOADS]{}; /**< energy received by each load in Joules */
+  static inline uint8_t boostedLoads{ 0 };                 /**< loads being forced, bit i for load i */
+  static inline bool inOffPeak{ false };                   /**< state of the off-peak period at the previous call */
+  static inline uint32_t offPeakStart{ 0 };                /**< uptime at the begin of the current off-peak period */
+};
 
-inline constexpr auto rg_OffsetForce{ _rg_OffsetForce< NO_OF_DUMPLOADS, ul_OFF_PEAK_DURATION >() }; /**< start & stop offsets for each load */
+inline EnergyTargetBoost energyTargetBoost; /**< boost towards the daily energy targets */
 
 /**
  * @brief Print the settings for off-peak period
@@ -78,37 +144,19 @@ inline void printDualTariffConfiguration()
   Serial.print(iTemperatureThreshold);
   Serial.println(F("°C."));
 
+  Serial.println(F("\tForce windows (in minutes):"));
+  forceSchedule.printConfiguration(Serial);
+
   for (uint8_t i = 0; i < NO_OF_DUMPLOADS; ++i)
   {
-    Serial.print(F("\tLoad #"));
-    Serial.print(i + 1);
-    Serial.println(F(":"));
-
-    Serial.print(F("\t\tStart "));
-    if (rg_ForceLoad[i].getStartOffset() >= 0)
-    {
-      Serial.print(rg_ForceLoad[i].getStartOffset());
-      Serial.print(F(" hours/minutes after begin of off-peak period "));
-    }
-    else
-    {
-      Serial.print(-rg_ForceLoad[i].getStartOffset());
-      Serial.print(F(" hours/minutes before the end of off-peak period "));
-    }
-    if (rg_ForceLoad[i].getDuration() == UINT16_MAX)
-    {
-      Serial.println(F("till the end of the period."));
-    }
-    else
+    if (loadEnergyTargets[i].target_Wh)
     {
-      Serial.print(F("for a duration of "));
-      Serial.print(rg_ForceLoad[i].getDuration());
-      Serial.println(F(" hour/minute(s)."));
+      Serial.print(F("\tLoad #"));
+      Serial.print(i + 1);
+      Serial.print(F(": daily energy target of "));
+      Serial.print(loadEnergyTargets[i].target_Wh);
+      Serial.println(F(" Wh."));
     }
-    Serial.print(F("\t\tCalculated offset in seconds: "));
-    Serial.println(rg_OffsetForce[i][0] * 0.001F);
-    Serial.print(F("\t\tCalculated duration in seconds: "));
-    Serial.println(rg_OffsetForce[i][1] * 0.001F);
   }
 }
 
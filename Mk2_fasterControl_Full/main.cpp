@@ -19,9 +19,15 @@ static_assert(__cplusplus >= 201703L, "See also : https://github.com/FredM67/PVR
 #include "processing.h"
 #include "types.h"
 #include "utils.h"
+#include "utils_commands.h"
+#include "utils_energy.h"
 #include "utils_relay.h"
+#include "utils_rtc.h"
+#include "utils_settings.h"
 #include "utils_display.h"
 #include "utils_oled.h"
+#include "utils_stream.h"
+#include "utils_trace.h"
 #include "validation.h"
 
 // --------------  general global variables -----------------
@@ -96,6 +102,25 @@ ISR(ADC_vect)
   }
 }
 
+/**
+ * @brief Fill the free RAM with STACK_CANARY before main() runs
+ * @details Placed in .init3, after the stack pointer has been set and before .data/.bss are initialised.
+ *          Naked: there's no return, the next init section follows. See getStackUnused().
+ *
+ */
+void paintStack() __attribute__((naked, used, section(".init3")));
+void paintStack()
+{
+  extern uint8_t _end;
+  extern uint8_t __stack;
+
+  uint8_t *p{ &_end };
+  while (p <= &__stack)
+  {
+    *p++ = STACK_CANARY;
+  }
+}
+
 /**
  * @brief This function set all 3 loads to full power.
  *
@@ -112,7 +137,7 @@ bool forceFullPower()
     static uint8_t previousState{ HIGH };
     if (previousState != pinState)
     {
-      DBUGLN(!pinState ? F("Trigger override!") : F("End override!"));
+      DBUGLN_Q(!pinState ? F("Trigger override!") : F("End override!"));
     }
 
     previousState = pinState;
@@ -133,20 +158,13 @@ bool forceFullPower()
 
 /**
  * @brief Proceed load priority rotation
- * 
+ * @details The priorities are rotated by the ISR on the next mains cycle, without waiting for it.
+ *          The new priorities are printed on IsrEvents::LOADS_ROTATED.
+ *
  */
 void proceedRotation()
 {
-  b_reOrderLoads = true;
-
-  // waits till the priorities have been rotated from inside the ISR
-  do
-  {
-    delay(10);
-  } while (b_reOrderLoads);
-
-  // prints the (new) load priorities
-  logLoadPriorities();
+  controlCommands.push(ControlCommands::ROTATE_LOADS);
 }
 
 /**
@@ -165,37 +183,35 @@ bool proceedLoadPrioritiesAndOverridingDualTariff(const int16_t currentTemperatu
   if (pinOffPeakState && !pinNewState)
   {
     // we start off-peak period
-    DBUGLN(F("Change to off-peak period!"));
-
-    ul_TimeOffPeak = millis();
+    DBUGLN_Q(F("Change to off-peak period!"));
 
     if constexpr (PRIORITY_ROTATION == RotationModes::AUTO)
     {
       proceedRotation();
     }
   }
-  else
-  {
-    const auto ulElapsedTime{ static_cast< uint32_t >(millis() - ul_TimeOffPeak) };
-    const auto pinState{ getPinState(forcePin) };
 
-    for (uint8_t i = 0; i < NO_OF_DUMPLOADS; ++i)
+  const auto forcedLoads{ static_cast< uint8_t >(forceSchedule.proceed(mainsClock, LOW == pinNewState)
+                                                 | energyTargetBoost.proceed(LOW == pinNewState, mainsClock.get_uptime())) };
+  const auto pinState{ getPinState(forcePin) };
+
+  for (uint8_t i = 0; i < NO_OF_DUMPLOADS; ++i)
+  {
+    // for each load, if we're within one of its force windows, trigger the ISR to turn the load ON
+    if (bit_read(forcedLoads, i))
     {
-      // for each load, if we're inside off-peak period and within the 'force period', trigger the ISR to turn the load ON
-      if (!pinOffPeakState && !pinNewState && (ulElapsedTime >= rg_OffsetForce[i][0]) && (ulElapsedTime < rg_OffsetForce[i][1]))
-      {
-        b_overrideLoadOn[i] = !pinState || (currentTemperature_x100 <= iTemperatureThreshold_x100);
-      }
-      else
-      {
-        b_overrideLoadOn[i] = !pinState;
-      }
+      b_overrideLoadOn[i] = !pinState || (currentTemperature_x100 <= iTemperatureThreshold_x100);
+    }
+    else
+    {
+      b_overrideLoadOn[i] = !pinState;
     }
   }
+
   // end of off-peak period
   if (!pinOffPeakState && pinNewState)
   {
-    DBUGLN(F("Change to peak period!"));
+    DBUGLN_Q(F("Change to peak period!"));
   }
 
   pinOffPeakState = pinNewState;
@@ -205,7 +221,7 @@ bool proceedLoadPrioritiesAndOverridingDualTariff(const int16_t currentTemperatu
 
 /**
  * @brief This function changes the value of the load priorities.
- * @details Since we don't have access to a clock, we detect the offPeak start from the main energy meter.
+ * @details The offPeak start is detected from the main energy meter.
  *          Additionally, when off-peak period starts, we rotate the load priorities for the next day.
  *
  * @param currentTemperature_x100 current temperature x 100 (default to 0 if deactivated)
@@ -226,7 +242,7 @@ bool proceedLoadPrioritiesAndOverriding(const int16_t currentTemperature_x100)
 
     if (pinRotationState && !pinNewState)
     {
-      DBUGLN(F("Trigger rotation!"));
+      DBUGLN_Q(F("Trigger rotation!"));
 
       proceedRotation();
     }
@@ -242,14 +258,18 @@ bool proceedLoadPrioritiesAndOverriding(const int16_t currentTemperature_x100)
     }
   }
 
+  constexpr int16_t iTemperatureThreshold_x100{ iTemperatureThreshold * 100 };
+  const auto forcedLoads{ forceSchedule.proceed(mainsClock, false) };  // without dual tariff, only the time-of-day windows apply
+  bool pinForced{ false };
+
   if constexpr (OVERRIDE_PIN_PRESENT)
   {
-    const auto pinState{ getPinState(forcePin) };
+    pinForced = !getPinState(forcePin);
+  }
 
-    for (auto &bOverrideLoad : b_overrideLoadOn)
-    {
-      bOverrideLoad = !pinState;
-    }
+  for (uint8_t i = 0; i < NO_OF_DUMPLOADS; ++i)
+  {
+    b_overrideLoadOn[i] = pinForced || (bit_read(forcedLoads, i) && currentTemperature_x100 <= iTemperatureThreshold_x100);
   }
 
   return false;
@@ -269,7 +289,7 @@ void checkDiversionOnOff()
     static auto previousState{ HIGH };
     if (previousState != pinState)
     {
-      DBUGLN(!pinState ? F("Trigger diversion OFF!") : F("End diversion OFF!"));
+      DBUGLN_Q(!pinState ? F("Trigger diversion OFF!") : F("End diversion OFF!"));
     }
 
     previousState = pinState;
@@ -280,7 +300,60 @@ void checkDiversionOnOff()
 }
 
 /**
- * @brief Update the temperature and send a new request
+ * @brief Compute which loads may divert, according to their temperature limit
+ * @details Within the derating band, a load may divert during a share of each derating window
+ *          which is proportional to its distance to the limit. At the limit, it may not divert at all.
+ *          A load whose sensor doesn't answer is not limited, its own thermostat still protects it.
+ *          Called every second.
+ * 
+ */
+void updateLoadsDerating()
+{
+  constexpr int16_t band_x100{ TEMPERATURE_DERATING_BAND * 100 };
+
+  static uint8_t secondInWindow{ 0 };
+
+  uint8_t allowed{ 0xFF };
+  uint8_t i{ NO_OF_DUMPLOADS };
+  do
+  {
+    --i;
+    const auto &loadLimit{ loadTemperatureLimits[i] };
+    if (0xff == loadLimit.sensor)
+    {
+      continue;
+    }
+
+    const auto temperature_x100{ temperatureSensing.get_temperature(loadLimit.sensor) };
+    if (OUTOFRANGE_TEMPERATURE == temperature_x100 || DEVICE_DISCONNECTED_RAW == temperature_x100)
+    {
+      continue;
+    }
+
+    const int16_t margin_x100 = loadLimit.limit * 100 - temperature_x100;
+    if (margin_x100 >= band_x100)
+    {
+      continue;
+    }
+
+    // the load may divert during margin / band of the window
+    if (margin_x100 <= 0 || secondInWindow * band_x100 >= margin_x100 * DERATING_WINDOW_IN_SECONDS)
+    {
+      bit_clear(allowed, i);
+    }
+  } while (i);
+
+  allowedLoads = allowed;
+
+  if (++secondInWindow >= DERATING_WINDOW_IN_SECONDS)
+  {
+    secondInWindow = 0;
+  }
+}
+
+/**
+ * @brief Copy the latest temperatures to the data logs
+ * @details The values have been read in the background by temperatureSensing.proceed().
  * 
  */
 void updateTemperature()
@@ -290,18 +363,9 @@ void updateTemperature()
     uint8_t idx{ temperatureSensing.get_size() };
     do
     {
-      auto tmp = temperatureSensing.readTemperature(--idx);
-
-      // if read temperature is 85 and the delta with previous is greater than 5, skip the value
-      if (8500 == tmp && (abs(tmp - tx_data.temperature_x100[idx]) > 500))
-      {
-        tmp = DEVICE_DISCONNECTED_RAW;
-      }
-
-      tx_data.temperature_x100[idx] = tmp;
+      --idx;
+      tx_data.temperature_x100[idx] = temperatureSensing.get_temperature(idx);
     } while (idx);
-
-    temperatureSensing.requestTemperatures();  // for use next time around
   }
 }
 
@@ -311,18 +375,18 @@ void updateTemperature()
  */
 void processCalcultationsForLogging()
 {
-  tx_data.powerGrid = copyOf_sumP_grid_overDL_Period / copyOf_sampleSetsDuringThisDatalogPeriod * powerCal_grid;
+  tx_data.powerGrid = copyOf_sumP_grid_overDL_Period / copyOf_sampleSetsDuringThisDatalogPeriod * settings.gridPowerCal;
   tx_data.powerGrid *= -1;
 
-  tx_data.powerDiverted = copyOf_sumP_diverted_overDL_Period / copyOf_sampleSetsDuringThisDatalogPeriod * powerCal_diverted;
+  tx_data.powerDiverted = copyOf_sumP_diverted_overDL_Period / copyOf_sampleSetsDuringThisDatalogPeriod * settings.divertedPowerCal;
 
   if constexpr (DATALOG_PERIOD_IN_SECONDS > 10)
   {
-    tx_data.Vrms_L_x100 = static_cast< int32_t >((100 << 2) * f_voltageCal * sqrt(copyOf_sum_Vsquared / copyOf_sampleSetsDuringThisDatalogPeriod));
+    tx_data.Vrms_L_x100 = static_cast< int32_t >((100 << 2) * settings.voltageCal * sqrt(copyOf_sum_Vsquared / copyOf_sampleSetsDuringThisDatalogPeriod));
   }
   else
   {
-    tx_data.Vrms_L_x100 = static_cast< int32_t >(100 * f_voltageCal * sqrt(copyOf_sum_Vsquared / copyOf_sampleSetsDuringThisDatalogPeriod));
+    tx_data.Vrms_L_x100 = static_cast< int32_t >(100 * settings.voltageCal * sqrt(copyOf_sum_Vsquared / copyOf_sampleSetsDuringThisDatalogPeriod));
   }
 }
 
@@ -337,10 +401,15 @@ void setup()
   delay(delayBeforeSerialStarts);  // allow time to open Serial monitor
 
   DEBUG_PORT.begin(9600);
-  Serial.begin(9600);  // initialize Serial interface, Do NOT set greater than 9600
+  Serial.begin(SERIAL_BAUD_RATE);  // initialize Serial interface, see SERIAL_BAUD_RATE
 
   pinMode(4, OUTPUT);
 
+  settingsStore.load();  // the defaults are kept if nothing valid has been saved
+  applySettings();
+
+  energyCounters.begin();  // restores the energy counters saved before the last power cut
+
   // On start, always display config info in the serial monitor
   printConfiguration();
 
@@ -348,6 +417,11 @@ void setup()
 
   initializeDisplay();
 
+  if constexpr (TEMP_SENSOR_PRESENT)
+  {
+    temperatureSensing.initTemperatureSensors();  // searches the bus, must be done before the ADC starts
+  }
+
   // initializes all loads to OFF at startup
   initializeProcessing();
 
@@ -355,9 +429,9 @@ void setup()
 
   logLoadPriorities();
 
-  if constexpr (TEMP_SENSOR_PRESENT)
+  if constexpr (RF_CHIP_PRESENT)
   {
-    temperatureSensing.initTemperatureSensors();
+    rf.initialize();
   }
 
   DBUG(F(">>free RAM = "));
@@ -374,16 +448,59 @@ void setup()
 void loop()
 {
   static bool initLoop{ true };
-  static uint8_t perSecondTimer{ 0 };
+  static uint32_t lastCycleCount{ 0 };
+  static uint16_t perSecondTimer{ 0 };
   static bool bOffPeak{ false };
-  static uint8_t timerForDisplayUpdate{ 0 };
+  static uint16_t timerForDisplayUpdate{ 0 };
   static int16_t iTemperature_x100{ 0 };
 
-  if (b_newCycle)  // flag is set after every pair of ADC conversions
+  if constexpr (STREAM_PERIOD_IN_MAINS_CYCLES != 0)
+  {
+    streamDatalog.proceed();  // sends the streaming record first, it has priority over the text output
+  }
+
+  serialTxQueue.pump();  // sends pending Serial output without blocking
+
+  if constexpr (TRACE_CAPTURE)
+  {
+    traceBuffer.proceedDump();  // prints a frozen trace, one line per pass
+  }
+
+  proceedLoadPriorities();  // prints the load priorities, one line per pass
+
+  if constexpr (RF_CHIP_PRESENT)
+  {
+    rf.proceed();  // sends the pending RF packet without blocking
+  }
+
+  if constexpr (TEMP_SENSOR_PRESENT)
+  {
+    temperatureSensing.proceed();  // one OneWire step at most
+  }
+
+  mainsClock.proceed();
+
+  energyCounters.proceed();
+
+  commandInterpreter.proceed();
+
+  // the timers count the mains cycles elapsed since the previous pass,
+  // so they stay accurate even when loop() has been blocked for several cycles
+  const uint32_t cycleCount{ getMainsCycleCount() };
+  const auto elapsedCycles{ static_cast< uint16_t >(cycleCount - lastCycleCount) };
+  lastCycleCount = cycleCount;
+
+  if (elapsedCycles)
   {
-    b_newCycle = false;  // reset the flag
-    ++perSecondTimer;
-    ++timerForDisplayUpdate;
+    perSecondTimer += elapsedCycles;
+    timerForDisplayUpdate += elapsedCycles;
+
+    if (elapsedCycles > maxLoopLatency_cycles)
+    {
+      maxLoopLatency_cycles = elapsedCycles;
+    }
+
+    proceedOLEDPages(elapsedCycles);
 
     if (timerForDisplayUpdate >= UPDATE_PERIOD_FOR_DISPLAYED_DATA)
     {  // the 4-digit display needs to be refreshed every few mS. For convenience,
@@ -407,7 +524,13 @@ void loop()
 
     if (perSecondTimer >= SUPPLY_FREQUENCY)
     {
-      perSecondTimer = 0;
+      // the seconds elapsed while loop() was blocked are caught up, not lost
+      uint16_t elapsedSeconds{ 0 };
+      do
+      {
+        perSecondTimer -= SUPPLY_FREQUENCY;
+        ++elapsedSeconds;
+      } while (perSecondTimer >= SUPPLY_FREQUENCY);
 
       if constexpr (WATCHDOG_PIN_PRESENT)
       {
@@ -421,14 +544,36 @@ void loop()
 
       checkDiversionOnOff();
 
+      if constexpr (TEMP_SENSOR_PRESENT)
+      {
+        temperatureSensing.requestTemperatures();  // starts the conversions of the sensors which are due
+
+        iTemperature_x100 = temperatureSensing.get_temperature(0);  // the first sensor is used for the override
+
+        updateLoadsDerating();
+      }
+
       if (!forceFullPower())
       {
         bOffPeak = proceedLoadPrioritiesAndOverriding(iTemperature_x100);  // called every second
       }
 
+      // loads forced with the "force" command
+      const auto manuallyForcedLoads{ commandInterpreter.get_forcedLoads() };
+      for (uint8_t i = 0; i < NO_OF_DUMPLOADS; ++i)
+      {
+        if (bit_read(manuallyForcedLoads, i))
+        {
+          b_overrideLoadOn[i] = true;
+        }
+      }
+
       if constexpr (RELAY_DIVERSION)
       {
-        relays.inc_duration();
+        do
+        {
+          relays.inc_duration();  // the durations of the relays count in seconds
+        } while (--elapsedSeconds);
         relays.proceed_relays();
       }
 
@@ -436,27 +581,44 @@ void loop()
     }
   }
 
-  if (b_datalogEventPending)
+  IsrEvents event;
+  while (isrEvents.pop(event))  // events are handled in the order of the ISR
   {
-    if (initLoop)
+    if (IsrEvents::LOADS_ROTATED == event)
     {
-      initLoop = false;
-      clearDisplay();
+      logLoadPriorities();  // prints the new load priorities
     }
+    else if (IsrEvents::DATALOG == event)
+    {
+      if (initLoop)
+      {
+        initLoop = false;
+        clearDisplay();
+      }
 
-    b_datalogEventPending = false;
+      processCalcultationsForLogging();
 
-    processCalcultationsForLogging();
+      commandInterpreter.recordSampleSets(copyOf_lowestNoOfSampleSetsPerMainsCycle);
 
-    if constexpr (RELAY_DIVERSION)
-    {
-      relays.update_average(tx_data.powerGrid);
-    }
+      energyCounters.addDatalogPeriod();
 
-    updateTemperature();
+      if constexpr (DUAL_TARIFF)
+      {
+        energyTargetBoost.addDatalogPeriod(tx_data.powerDiverted);
+      }
 
-    updateOLED(divertedEnergyTotal_Wh);
+      if constexpr (RELAY_DIVERSION)
+      {
+        relays.update_average(tx_data.powerGrid);
+      }
+
+      updateTemperature();
 
-    sendResults(bOffPeak);
+      updateOLED(bOffPeak);
+
+      sendResults(bOffPeak);
+
+      maxLoopLatency_cycles = 0;  // measured again over the next datalog period
+    }
   }
 }  // end of loop()
\ No newline at end of file
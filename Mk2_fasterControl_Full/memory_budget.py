@@ -0,0 +1,142 @@
+"""
+Memory budget report, run by PlatformIO after the link.
+
+The linker map gives the .text/.data/.bss size of each module (object file),
+the .su files produced by -fstack-usage give the largest stack frame of each module.
+The build fails when the static RAM or the flash exceeds the budget of the environment:
+
+  custom_ram_budget   = max .data + .bss in bytes, the rest of the RAM is left to the stack
+  custom_flash_budget = max .text + .data in bytes
+
+The real peak stack use is measured at runtime (see paintStack() in utils.h).
+"""
+
+import os
+import re
+from collections import defaultdict
+
+Import("env")
+
+RAM_SIZE = 2048  # ATmega328P
+
+map_path = os.path.join(env.subst("$BUILD_DIR"), "firmware.map")
+
+env.Append(LINKFLAGS=["-Wl,-Map," + map_path])
+env.Append(CCFLAGS=["-fstack-usage"])
+
+
+def get_budget(name, default):
+  try:
+    return int(env.GetProjectOption(name, default))
+  except ValueError:
+    return default
+
+
+def module_name(path):
+  """ 'libFrameworkArduino.a(HardwareSerial0.cpp.o)' -> 'HardwareSerial0.cpp' """
+  match = re.search(r"\(([^)]+)\)$", path)
+  name = match.group(1) if match else os.path.basename(path)
+  return name[:-2] if name.endswith(".o") else name
+
+
+def parse_map(path):
+  """ Return {module: {'text': n, 'data': n, 'bss': n}} and the size of the output sections """
+  modules = defaultdict(lambda: defaultdict(int))
+  totals = defaultdict(int)
+
+  output_section = None
+  pending_name = None
+  in_memory_map = False
+
+  with open(path, encoding="utf-8", errors="replace") as f:
+    for line in f:
+      line = line.rstrip("\n")
+      if not in_memory_map:
+        in_memory_map = line.startswith("Linker script and memory map")
+        continue
+
+      # output section, e.g. ".bss            0x00800100      0x1f2"
+      match = re.match(r"^(\.\w+)\s+0x[0-9a-f]+\s+0x([0-9a-f]+)", line)
+      if match:
+        output_section = match.group(1)
+        totals[output_section] = int(match.group(2), 16)
+        continue
+      match = re.match(r"^(\.\w+)\s*$", line)
+      if match:
+        output_section = match.group(1)
+        continue
+
+      if output_section not in (".text", ".data", ".bss"):
+        continue
+
+      # input section, the name may be alone on its line when it's too long
+      match = re.match(r"^ (\.\S+|COMMON)\s*$", line)
+      if match:
+        pending_name = match.group(1)
+        continue
+      match = re.match(r"^ (?:(\.\S+|COMMON)\s+|\s+)0x[0-9a-f]+\s+0x([0-9a-f]+)\s+(\S.*)$", line)
+      if match and (match.group(1) or pending_name):
+        size = int(match.group(2), 16)
+        if size:
+          modules[module_name(match.group(3))][output_section[1:]] += size
+      pending_name = None
+
+  return modules, totals
+
+
+def parse_stack_usage(build_dir):
+  """ Return {module: (largest frame, function)} from the .su files """
+  frames = {}
+  for root, _, files in os.walk(build_dir):
+    for name in files:
+      if not name.endswith(".su"):
+        continue
+      module = name[:-3]
+      with open(os.path.join(root, name), encoding="utf-8", errors="replace") as f:
+        for line in f:
+          fields = line.rstrip("\n").split("\t")
+          if len(fields) < 2 or not fields[1].isdigit():
+            continue
+          size = int(fields[1])
+          if module not in frames or size > frames[module][0]:
+            frames[module] = (size, fields[0].split(":")[-1])
+  return frames
+
+
+def report(target, source, env):
+  if not os.path.isfile(map_path):
+    print("Memory budget: no linker map, skipped")
+    return
+
+  modules, totals = parse_map(map_path)
+  frames = parse_stack_usage(env.subst("$BUILD_DIR"))
+
+  print("")
+  print("Memory budget of [env:%s]" % env.subst("$PIOENV"))
+  print("  %-28s %7s %6s %6s %6s" % ("module", "flash", "data", "bss", "stack"))
+  for name, sizes in sorted(modules.items(), key=lambda m: -(m[1]["data"] + m[1]["bss"])):
+    frame = frames.get(name, (0, ""))[0]
+    print("  %-28s %7d %6d %6d %6s" % (name[:28], sizes["text"], sizes["data"], sizes["bss"], frame or ""))
+
+  static_ram = totals[".data"] + totals[".bss"]
+  flash = totals[".text"] + totals[".data"]
+  ram_budget = get_budget("custom_ram_budget", RAM_SIZE)
+  flash_budget = get_budget("custom_flash_budget", 32256)
+
+  print("")
+  print("  static RAM : %5d / %5d bytes (budget), %d bytes left for the stack" % (static_ram, ram_budget, RAM_SIZE - static_ram))
+  print("  flash      : %5d / %5d bytes (budget)" % (flash, flash_budget))
+
+  deepest = sorted(((size, fn, module) for module, (size, fn) in frames.items()), reverse=True)[:5]
+  if deepest:
+    print("  largest stack frames (bytes, without the callers):")
+    for size, fn, module in deepest:
+      print("    %4d  %s (%s)" % (size, fn, module))
+  print("")
+
+  if static_ram > ram_budget or flash > flash_budget:
+    print("******** Memory budget exceeded ! ********")
+    env.Exit(1)
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", report)
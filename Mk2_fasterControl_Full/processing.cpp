@@ -5,6 +5,8 @@
 #include "dualtariff.h"
 #include "processing.h"
 #include "utils_pins.h"
+#include "utils_settings.h"
+#include "utils_trace.h"
 
 // Define operating limits for the LP filters which identify DC offset in the voltage
 // sample streams. By limiting the output range, these filters always should start up
@@ -15,18 +17,21 @@ constexpr int16_t DCoffset_I{ 512 };                    /**< nominal mid-point v
 
 int32_t DCoffset_V_long{ 512L * 256 }; /**< <--- for LPF */
 
+// The values below depend on the runtime settings, see applySettings().
+// They are computed once when the settings are loaded or changed, so the ISR only reads them.
+
 /**< main energy bucket for single-phase use, with units of Joules * SUPPLY_FREQUENCY */
-constexpr int32_t capacityOfEnergyBucket_long{ static_cast< int32_t >(WORKING_ZONE_IN_JOULES * SUPPLY_FREQUENCY * (1 / powerCal_grid)) };  // depends on powerCal, frequency & the 'sweetzone' size.
+int32_t capacityOfEnergyBucket_long{ static_cast< int32_t >(WORKING_ZONE_IN_JOULES * SUPPLY_FREQUENCY * (1 / powerCal_grid)) };  // depends on powerCal, frequency & the 'sweetzone' size.
 /**< for resetting flexible thresholds */
-constexpr int32_t midPointOfEnergyBucket_long{ capacityOfEnergyBucket_long >> 1 };  // used for 'normal' and single-threshold 'AF' logic
+int32_t midPointOfEnergyBucket_long{ capacityOfEnergyBucket_long >> 1 };  // used for 'normal' and single-threshold 'AF' logic
 
-constexpr int32_t lowerThreshold_default{ capacityOfEnergyBucket_long >> 1 };
-constexpr int32_t upperThreshold_default{ capacityOfEnergyBucket_long >> 1 };
+int32_t lowerThreshold_default{ capacityOfEnergyBucket_long >> 1 };
+int32_t upperThreshold_default{ capacityOfEnergyBucket_long >> 1 };
 
 // to avoid the diverted energy accumulator 'creeping' when the load is not active
-constexpr int32_t antiCreepLimit_inIEUperMainsCycle{ static_cast< int32_t >(ANTI_CREEP_LIMIT * (1 / powerCal_grid)) };
+int32_t antiCreepLimit_inIEUperMainsCycle{ static_cast< int32_t >(ANTI_CREEP_LIMIT * (1 / powerCal_grid)) };
 
-constexpr int32_t requiredExportPerMainsCycle_inIEU{ static_cast< int32_t >(REQUIRED_EXPORT_IN_WATTS * (1 / powerCal_grid)) };
+int32_t requiredExportPerMainsCycle_inIEU{ static_cast< int32_t >(REQUIRED_EXPORT_IN_WATTS * (1 / powerCal_grid)) };
 
 // When using integer maths, calibration values that have supplied in floating point
 // form need to be rescaled.
@@ -53,7 +58,15 @@ int32_t upperEnergyThreshold;     /**< dynamic upper threshold */
 // accumulator's value is decremented accordingly. The calculation below is to determine
 // the scaling for this accumulator.
 
-constexpr int32_t IEU_per_Wh{ static_cast< int32_t >(JOULES_PER_WATT_HOUR * SUPPLY_FREQUENCY * (1 / powerCal_diverted)) };  // depends on powerCal, frequency & the 'sweetzone' size.
+int32_t IEU_per_Wh{ static_cast< int32_t >(JOULES_PER_WATT_HOUR * SUPPLY_FREQUENCY * (1 / powerCal_diverted)) };  // depends on powerCal, frequency & the 'sweetzone' size.
+
+// The imported and exported energies (using CT1) are accumulated the same way, with the
+// calibration of the grid CT. Both accumulators are only used from within the ISR.
+
+int32_t IEU_per_Wh_grid{ static_cast< int32_t >(JOULES_PER_WATT_HOUR * SUPPLY_FREQUENCY * (1 / powerCal_grid)) };  // depends on powerCal & frequency
+
+int32_t importedEnergyRecent_IEU{ 0 }; /**< hi-res accumulator of imported energy */
+int32_t exportedEnergyRecent_IEU{ 0 }; /**< hi-res accumulator of exported energy */
 
 bool recentTransition{ false };                   /**< a load state has been recently toggled */
 uint8_t postTransitionCount;                      /**< counts the number of cycle since last transition */
@@ -89,6 +102,12 @@ uint16_t countLoadON[NO_OF_DUMPLOADS];         /**< Number of cycle the load was
 
 remove_cv< remove_reference< decltype(DATALOG_PERIOD_IN_MAINS_CYCLES) >::type >::type n_cycleCountForDatalogging{ 0 }; /**< for counting how often datalog is updated */
 
+int32_t sumP_grid_overStreamPeriod{ 0 };        /**< for summation of 'real power' during streaming period */
+int32_t sumP_diverted_overStreamPeriod{ 0 };    /**< for summation of 'real power' during streaming period */
+uint16_t sampleSetsDuringThisStreamPeriod{ 0 }; /**< number of sample sets during each streaming period */
+uint8_t n_cycleCountForStreaming{ 0 };          /**< for counting how often the streaming datalog is updated */
+uint8_t n_streamPeriods{ 0 };                   /**< number of streaming periods (modulo 256), used as sequence number */
+
 bool beyondStartUpPeriod{ false }; /**< start-up delay, allows things to settle */
 
 /**
@@ -236,22 +255,24 @@ void updatePortsStates()
  */
 void updatePhysicalLoadStates()
 {
-  if constexpr (PRIORITY_ROTATION != RotationModes::OFF)
+  // the rotation can be requested in every rotation mode (see the "rotate" command)
+  ControlCommands command;
+  if (controlCommands.pop(command) && ControlCommands::ROTATE_LOADS == command && NO_OF_DUMPLOADS > 1)
   {
-    if (b_reOrderLoads)
+    uint8_t i{ NO_OF_DUMPLOADS - 1 };
+    const auto temp{ loadPrioritiesAndState[i] };
+    do
     {
-      uint8_t i{ NO_OF_DUMPLOADS - 1 };
-      const auto temp{ loadPrioritiesAndState[i] };
-      do
-      {
-        loadPrioritiesAndState[i] = loadPrioritiesAndState[i - 1];
-        --i;
-      } while (i);
-      loadPrioritiesAndState[0] = temp;
+      loadPrioritiesAndState[i] = loadPrioritiesAndState[i - 1];
+      --i;
+    } while (i);
+    loadPrioritiesAndState[0] = temp;
 
-      b_reOrderLoads = false;
-    }
+    isrEvents.push(IsrEvents::LOADS_ROTATED);
+  }
 
+  if constexpr (PRIORITY_ROTATION != RotationModes::OFF)
+  {
     if constexpr (!DUAL_TARIFF)
     {
       if (0x00 == (loadPrioritiesAndState[0] & loadStateOnBit))
@@ -436,6 +457,11 @@ void processRawSamples()
          * - update the driver lines for each of the loads.
          */
 
+        if constexpr (TEMP_SENSOR_PRESENT)
+        {
+          removeDeratedLoads();  // loads at their temperature limit are not available anymore
+        }
+
         // Restrictions apply for the period immediately after a load has been switched.
         // Here the recentTransition flag is checked and updated as necessary.
         if (recentTransition)
@@ -599,6 +625,29 @@ void processStartNewCycle()
   }
 }
 
+/**
+ * @brief Get the state of the physical loads as a bit field
+ *
+ * @return uint8_t bit i is set when the physical load #i is ON
+ *
+ * @ingroup TimeCritical
+ */
+uint8_t getLoadsON()
+{
+  uint8_t loadsON{ 0 };
+  uint8_t i{ NO_OF_DUMPLOADS };
+  do
+  {
+    --i;
+    if (LoadStates::LOAD_ON == physicalLoadState[i])
+    {
+      bit_set(loadsON, i);
+    }
+  } while (i);
+
+  return loadsON;
+}
+
 /**
  * @brief Process the start of a new +ve half cycle, just after the zero-crossing point.
  *
@@ -615,8 +664,18 @@ void processPlusHalfCycle()
     lowestNoOfSampleSetsPerMainsCycle = sampleSetsDuringThisMainsCycle;
   }
 
+  if constexpr (TRACE_CAPTURE)
+  {
+    traceBuffer.record(realEnergy_grid, realEnergy_diverted, energyInBucket_prediction, getLoadsON(), sampleSetsDuringThisMainsCycle);
+  }
+
   processDataLogging();
 
+  if constexpr (STREAM_PERIOD_IN_MAINS_CYCLES != 0)
+  {
+    processStreamLogging();
+  }
+
   // clear the per-cycle accumulators for use in this new mains cycle.
   sampleSetsDuringThisMainsCycle = 0;
   sumP_grid = 0;
@@ -693,6 +752,28 @@ void processLatestContribution()
   int32_t realPower_grid = sumP_grid / sampleSetsDuringThisMainsCycle;          // proportional to Watts
   int32_t realPower_diverted = sumP_diverted / sampleSetsDuringThisMainsCycle;  // proportional to Watts
 
+  // The imported or exported energy is accumulated before the required export is applied,
+  // so that it matches the supply meter. Whole Wh are then recorded separately.
+  // At this stage, the grid power is positive on export (surplus) and negative on import.
+  if (realPower_grid < 0)
+  {
+    importedEnergyRecent_IEU -= realPower_grid;
+    if (importedEnergyRecent_IEU > IEU_per_Wh_grid)
+    {
+      importedEnergyRecent_IEU -= IEU_per_Wh_grid;
+      ++importedEnergyTotal_Wh;
+    }
+  }
+  else
+  {
+    exportedEnergyRecent_IEU += realPower_grid;
+    if (exportedEnergyRecent_IEU > IEU_per_Wh_grid)
+    {
+      exportedEnergyRecent_IEU -= IEU_per_Wh_grid;
+      ++exportedEnergyTotal_Wh;
+    }
+  }
+
   realPower_grid -= requiredExportPerMainsCycle_inIEU;  // <- useful for PV simulation
 
   // Next, the energy content of this power rating needs to be determined.  Energy is
@@ -720,7 +801,7 @@ void processLatestContribution()
   // The latest contribution can now be added to this energy bucket
   energyInBucket_long += realEnergy_grid;
 
-  b_newCycle = true;  //  a 50 Hz 'tick' for use by the main code
+  ++mainsCycleCount;  //  a 50 Hz 'tick' for use by the main code, never missed even if loop() is late
 }
 
 /**
@@ -818,9 +899,11 @@ uint8_t nextLogicalLoadToBeAdded() __attribute__((optimize("-O3")));
  */
 uint8_t nextLogicalLoadToBeAdded()
 {
+  const uint8_t allowed{ allowedLoads };
+
   for (uint8_t index = 0; index < NO_OF_DUMPLOADS; ++index)
   {
-    if (0x00 == (loadPrioritiesAndState[index] & loadStateOnBit))
+    if (0x00 == (loadPrioritiesAndState[index] & loadStateOnBit) && bit_read(allowed, loadPrioritiesAndState[index] & loadStateMask))
     {
       return (index);
     }
@@ -854,6 +937,30 @@ uint8_t nextLogicalLoadToBeRemoved()
   return (NO_OF_DUMPLOADS);
 }
 
+#if !defined(__DOXYGEN__)
+void removeDeratedLoads() __attribute__((optimize("-O3")));
+#endif
+/**
+ * @brief Switch OFF the loads which are not allowed to divert anymore
+ * @details The surplus is then taken over by the next load(s) on the following mains cycles.
+ *
+ * @ingroup TimeCritical
+ */
+void removeDeratedLoads()
+{
+  const uint8_t allowed{ allowedLoads };
+  uint8_t index{ NO_OF_DUMPLOADS };
+
+  do
+  {
+    --index;
+    if (!bit_read(allowed, loadPrioritiesAndState[index] & loadStateMask))
+    {
+      loadPrioritiesAndState[index] &= loadStateMask;
+    }
+  } while (index);
+}
+
 #if !defined(__DOXYGEN__)
 void processDataLogging() __attribute__((optimize("-O3")));
 #endif
@@ -900,7 +1007,79 @@ void processDataLogging()
 
   // signal the main processor that logging data are available
   // we skip the period from start to running stable
-  b_datalogEventPending = beyondStartUpPeriod;
+  if (beyondStartUpPeriod)
+  {
+    isrEvents.push(IsrEvents::DATALOG);
+  }
+}
+
+#if !defined(__DOXYGEN__)
+void processStreamLogging() __attribute__((optimize("-O3")));
+#endif
+/**
+ * @brief Process with the streaming datalog.
+ * @details Every STREAM_PERIOD_IN_MAINS_CYCLES mains cycles, copies of the power sums are made
+ *          for the main code, in the same way as for the datalog.
+ *
+ * @ingroup TimeCritical
+ */
+void processStreamLogging()
+{
+  sumP_grid_overStreamPeriod += sumP_grid;
+  sumP_diverted_overStreamPeriod += sumP_diverted;
+  sampleSetsDuringThisStreamPeriod += sampleSetsDuringThisMainsCycle;
+
+  if (++n_cycleCountForStreaming < STREAM_PERIOD_IN_MAINS_CYCLES)
+  {
+    return;  // streaming period not yet reached
+  }
+
+  n_cycleCountForStreaming = 0;
+
+  copyOf_sumP_grid_overStreamPeriod = sumP_grid_overStreamPeriod;
+  sumP_grid_overStreamPeriod = 0;
+
+  copyOf_sumP_diverted_overStreamPeriod = sumP_diverted_overStreamPeriod;
+  sumP_diverted_overStreamPeriod = 0;
+
+  copyOf_sampleSetsDuringThisStreamPeriod = sampleSetsDuringThisStreamPeriod;
+  sampleSetsDuringThisStreamPeriod = 0;
+
+  copyOf_loadsON = getLoadsON();
+  copyOf_streamSeq = n_streamPeriods++;
+
+  b_streamEventPending = beyondStartUpPeriod;
+}
+
+/**
+ * @brief Compute the values used by the ISR from the runtime settings
+ * @details To be called after the settings have been loaded or changed.
+ *          The floating-point maths is done here, never in the ISR.
+ *
+ */
+void applySettings()
+{
+  const float invGridPowerCal{ 1 / settings.gridPowerCal };
+
+  const int32_t capacity{ static_cast< int32_t >(settings.workingZone_J * SUPPLY_FREQUENCY * invGridPowerCal) };
+  const int32_t antiCreepLimit{ static_cast< int32_t >(settings.antiCreepLimit_J * invGridPowerCal) };
+  const int32_t requiredExport{ static_cast< int32_t >(settings.requiredExport_W * invGridPowerCal) };
+  const int32_t perWh{ static_cast< int32_t >(JOULES_PER_WATT_HOUR * SUPPLY_FREQUENCY * (1 / settings.divertedPowerCal)) };
+  const int32_t perWh_grid{ static_cast< int32_t >(JOULES_PER_WATT_HOUR * SUPPLY_FREQUENCY * invGridPowerCal) };
+  const int32_t importSpike{ static_cast< int32_t >(TRACE_IMPORT_SPIKE_IN_WATTS * invGridPowerCal) };
+
+  const uint8_t oldSREG{ SREG };
+  cli();
+  capacityOfEnergyBucket_long = capacity;
+  midPointOfEnergyBucket_long = capacity >> 1;
+  lowerThreshold_default = capacity >> 1;
+  upperThreshold_default = capacity >> 1;
+  antiCreepLimit_inIEUperMainsCycle = antiCreepLimit;
+  requiredExportPerMainsCycle_inIEU = requiredExport;
+  IEU_per_Wh = perWh;
+  IEU_per_Wh_grid = perWh_grid;
+  traceImportSpike_IEU = importSpike;
+  SREG = oldSREG;
 }
 
 /**
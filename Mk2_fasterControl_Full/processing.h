@@ -13,6 +13,8 @@
 #define PROCESSING_H
 
 #include "config.h"
+#include "types.h"
+#include "utils_ringbuffer.h"
 
 // allocation of analogue pins which are not dependent on the display type that is in use
 // **************************************************************************************
@@ -30,16 +32,19 @@ inline constexpr uint16_t delayBeforeSerialStarts{ 1000 };  // in milli-seconds,
 inline constexpr uint16_t startUpPeriod{ 3000 };            // in milli-seconds, to allow LP filter to settle
 
 // for interaction between the main processor and the ISR
+inline RingBuffer< IsrEvents, 4 > isrEvents;                /**< events from the ISR to the main processor */
+inline RingBuffer< ControlCommands, 4 > controlCommands;    /**< commands from the main processor to the ISR */
 inline volatile uint32_t absenceOfDivertedEnergyCount{ 0 }; /**< number of main cycles without diverted energy */
-inline volatile bool b_datalogEventPending{ false };        /**< async trigger to signal datalog is available */
-inline volatile bool b_newCycle{ false };                   /**< async trigger to signal start of new main cycle based on first phase */
 inline volatile bool b_overrideLoadOn[NO_OF_DUMPLOADS];     /**< async trigger to force specific load(s) to ON */
-inline volatile bool b_reOrderLoads{ false };               /**< async trigger for loads re-ordering */
+inline volatile uint8_t allowedLoads{ 0xFF };               /**< physical loads allowed to divert (bit i for load #i), see the temperature limits */
 inline volatile bool b_diversionOff{ false };               /**< async trigger to stop diversion */
 inline volatile bool EDD_isActive{ false };                 /**< energy diversion detection */
+inline volatile uint32_t mainsCycleCount{ 0 };              /**< mains cycles since start-up, see getMainsCycleCount() */
 
 inline volatile int32_t divertedEnergyRecent_IEU{ 0 };  // Hi-res accumulator of limited range
 inline volatile uint16_t divertedEnergyTotal_Wh{ 0 };   // WattHour register of 63K range
+inline volatile uint16_t importedEnergyTotal_Wh{ 0 };   // WattHour register of imported energy, wraps around
+inline volatile uint16_t exportedEnergyTotal_Wh{ 0 };   // WattHour register of exported energy, wraps around
 
 // since there's no real locking feature for shared variables, a couple of data
 // generated from inside the ISR are copied from time to time to be passed to the
@@ -52,13 +57,36 @@ inline volatile uint8_t copyOf_lowestNoOfSampleSetsPerMainsCycle;  /**<  */
 inline volatile uint16_t copyOf_sampleSetsDuringThisDatalogPeriod; /**< copy of for counting the sample sets during each datalogging period */
 inline volatile uint16_t copyOf_countLoadON[NO_OF_DUMPLOADS];      /**< copy of number of cycle the load was ON (over 1 datalog period) */
 
-#ifdef TEMP_ENABLED
-inline PayloadTx_struct< temperatureSensing.get_size() > tx_data; /**< logging data */
-#else
-inline PayloadTx_struct<> tx_data; /**< logging data */
-#endif
+// same mechanism for the streaming datalog
+inline volatile bool b_streamEventPending{ false };               /**< async trigger to signal a streaming record is available */
+inline volatile int32_t copyOf_sumP_grid_overStreamPeriod;        /**< copy of cumulative grid power over the streaming period */
+inline volatile int32_t copyOf_sumP_diverted_overStreamPeriod;    /**< copy of cumulative diverted power over the streaming period */
+inline volatile uint16_t copyOf_sampleSetsDuringThisStreamPeriod; /**< copy of the number of sample sets during the streaming period */
+inline volatile uint8_t copyOf_loadsON;                           /**< copy of the state of the loads at the end of the streaming period */
+inline volatile uint8_t copyOf_streamSeq;                         /**< copy of the number of streaming periods (modulo 256) */
+
+/**
+ * @brief Get the number of mains cycles since start-up
+ * @details The counter is incremented by the ISR on each mains cycle, so no cycle is missed
+ *          even when loop() is late. The timers of loop() compute the elapsed cycles from it.
+ *          It wraps around after more than 2 years at 50 Hz, the differences stay correct.
+ *
+ * @return uint32_t The number of mains cycles
+ */
+inline uint32_t getMainsCycleCount()
+{
+  const uint8_t oldSREG{ SREG };
+  cli();
+  const uint32_t count{ mainsCycleCount };
+  SREG = oldSREG;
+
+  return count;
+}
+
+inline PayloadTx tx_data; /**< logging data */
 
 void initializeProcessing();
+void applySettings();
 void initializeOptionalPins();
 void updatePhysicalLoadStates();
 void updatePortsStates();
@@ -83,7 +111,9 @@ inline void proceedLowEnergyLevel();
 inline void proceedHighEnergyLevel();
 inline uint8_t nextLogicalLoadToBeAdded();
 inline uint8_t nextLogicalLoadToBeRemoved();
+inline void removeDeratedLoads();
 inline void processLatestContribution();
+inline uint8_t getLoadsON();
 #else
 inline void processStartUp() __attribute__((always_inline));
 inline void processStartNewCycle() __attribute__((always_inline));
@@ -96,9 +126,12 @@ inline void proceedLowEnergyLevel() __attribute__((always_inline));
 inline void proceedHighEnergyLevel() __attribute__((always_inline));
 inline uint8_t nextLogicalLoadToBeAdded() __attribute__((always_inline));
 inline uint8_t nextLogicalLoadToBeRemoved() __attribute__((always_inline));
+inline void removeDeratedLoads() __attribute__((always_inline));
 inline void processLatestContribution() __attribute__((always_inline));
+inline uint8_t getLoadsON() __attribute__((always_inline));
 #endif
 
 void processDataLogging();
+void processStreamLogging();
 
 #endif  // PROCESSING_H
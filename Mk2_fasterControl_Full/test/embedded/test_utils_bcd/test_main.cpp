@@ -0,0 +1,157 @@
+/**
+ * @file test_main.cpp
+ * @author Frederic Metrich (frederic.metrich@live.fr)
+ * @test Tests for the BCD conversion
+ * @version 0.1
+ * @date 2024-11-29
+ *
+ * @copyright Copyright (c) 2024
+ *
+ * @note The benchmark compares bin2bcd() with the former divu10() chain of the 7-segments display.
+ *       The timings are printed as test messages.
+ *
+ */
+
+#include <Arduino.h>
+#include <U8g2lib.h>
+
+#include <unity.h>
+
+#include "utils_bcd.h"
+#include "FastDivision.h"
+
+constexpr uint16_t BENCHMARK_LOOPS{ 1000 };
+
+volatile uint16_t sink{ 0 }; /**< prevents the compiler from optimizing the benchmarks away */
+
+/**
+ * @brief Split a value into 4 digits, as done before with divu10()
+ *
+ */
+void digitsWithDivu10(uint16_t val, uint8_t *digits)
+{
+  uint8_t thisDigit = divu10(divu10(divu10(val)));
+  digits[0] = thisDigit;
+  val -= 1000 * thisDigit;
+
+  thisDigit = divu10(divu10(val));
+  digits[1] = thisDigit;
+  val -= 100 * thisDigit;
+
+  thisDigit = divu10(val);
+  digits[2] = thisDigit;
+  val -= 10 * thisDigit;
+
+  digits[3] = val;
+}
+
+/**
+ * @test Set up function for the tests
+ */
+void setUp(void)
+{
+  // set stuff up here
+}
+
+/**
+ * @test Tear down function for the tests
+ */
+void tearDown(void)
+{
+  // clean stuff up here
+}
+
+/**
+ * @test Compare bin2bcd with the divu10 chain for all values displayed with 4 digits
+ */
+void test_bin2bcd_all_values(void)
+{
+  uint8_t digits[4];
+
+  for (uint16_t val = 0; val < 10000; ++val)
+  {
+    const uint32_t bcd{ bin2bcd(val) };
+    digitsWithDivu10(val, digits);
+
+    TEST_ASSERT_EQUAL(digits[0], bcdDigit(bcd, 3));
+    TEST_ASSERT_EQUAL(digits[1], bcdDigit(bcd, 2));
+    TEST_ASSERT_EQUAL(digits[2], bcdDigit(bcd, 1));
+    TEST_ASSERT_EQUAL(digits[3], bcdDigit(bcd, 0));
+  }
+
+  TEST_ASSERT_EQUAL_HEX32(0x65535UL, bin2bcd(65535));
+}
+
+/**
+ * @test Test the fixed-point formatting
+ */
+void test_formatFixedPoint(void)
+{
+  char buffer[BCD_DIGITS + 3];
+
+  formatFixedPoint(buffer, 1234, 3);
+  TEST_ASSERT_EQUAL_STRING("1.234", buffer);
+
+  formatFixedPoint(buffer, 5, 2);
+  TEST_ASSERT_EQUAL_STRING("0.05", buffer);
+
+  formatFixedPoint(buffer, 0, 0);
+  TEST_ASSERT_EQUAL_STRING("0", buffer);
+
+  formatFixedPoint(buffer, 65535, 3);
+  TEST_ASSERT_EQUAL_STRING("65.535", buffer);
+
+  formatFixedPoint(buffer, 2312, 2, true);
+  TEST_ASSERT_EQUAL_STRING("-23.12", buffer);
+}
+
+/**
+ * @test Benchmark bin2bcd against the divu10 chain
+ */
+void test_benchmark(void)
+{
+  uint8_t digits[4];
+  char msg[48];
+
+  uint32_t start{ micros() };
+  for (uint16_t val = 0; val < BENCHMARK_LOOPS; ++val)
+  {
+    digitsWithDivu10(val * 9, digits);
+    sink = digits[3];
+  }
+  const uint32_t divu10_us{ micros() - start };
+
+  start = micros();
+  for (uint16_t val = 0; val < BENCHMARK_LOOPS; ++val)
+  {
+    sink = bin2bcd(val * 9);
+  }
+  const uint32_t bcd_us{ micros() - start };
+
+  snprintf(msg, sizeof(msg), "divu10: %lu ns, bin2bcd: %lu ns", divu10_us, bcd_us);  // µs for 1000 loops = ns per loop
+  TEST_MESSAGE(msg);
+
+  TEST_ASSERT_TRUE(bcd_us > 0);
+}
+
+/**
+ * @test Setup function for the test environment
+ */
+void setup()
+{
+  delay(1000);
+
+  UNITY_BEGIN();  // IMPORTANT LINE!
+}
+
+/**
+ * @test Loop function for running the tests
+ */
+void loop()
+{
+  RUN_TEST(test_bin2bcd_all_values);
+  RUN_TEST(test_formatFixedPoint);
+  RUN_TEST(test_benchmark);
+
+  UNITY_END();  // stop unit testing
+}
@@ -0,0 +1,197 @@
+/**
+ * @file test_main.cpp
+ * @author Frederic Metrich (frederic.metrich@live.fr)
+ * @brief Tests for the RF transmitter
+ * @version 0.1
+ * @date 2024-11-24
+ * 
+ * @copyright Copyright (c) 2024
+ * 
+ * @note These tests need an RFM12B module connected to the board.
+ *       The ADC runs free like in the router, and the interval between two ADC interrupts
+ *       is measured with Timer1 while a packet is being sent.
+ * 
+ */
+
+#define RF_PRESENT
+
+#include <Arduino.h>
+#include <U8g2lib.h>
+
+#include <unity.h>
+
+#include "utils_rf.h"
+
+constexpr RFTransmitter< PayloadTx_struct< 2 > > rf{ RFBands::RF_868MHZ, 10, 210 };
+
+constexpr uint16_t ADC_PERIOD_IN_TICKS{ 13 * 128 / 8 }; /**< one ADC conversion (104 µs) in Timer1 ticks (0.5 µs) */
+
+PayloadTx_struct< 2 > payload{ -512, 1830, 23145, { 5225, 1980 } };
+
+volatile uint16_t lastADC_tick{ 0 };
+volatile uint16_t maxADC_interval{ 0 };
+volatile uint16_t countADC{ 0 };
+
+/**
+ * @brief Measure the interval between 2 ADC interrupts
+ * 
+ */
+ISR(ADC_vect)
+{
+  const uint16_t now{ TCNT1 };
+  const uint16_t interval{ static_cast< uint16_t >(now - lastADC_tick) };
+
+  lastADC_tick = now;
+  ++countADC;
+
+  if (interval > maxADC_interval)
+  {
+    maxADC_interval = interval;
+  }
+}
+
+/**
+ * @brief Reset the measurement
+ * 
+ */
+void resetADC_stats()
+{
+  noInterrupts();
+  lastADC_tick = TCNT1;
+  maxADC_interval = 0;
+  countADC = 0;
+  interrupts();
+}
+
+/**
+ * @brief Send the payload, calling proceed() like loop() does
+ * 
+ * @return true if the transmitter went back to IDLE
+ */
+bool sendPayload()
+{
+  rf.queue(payload);
+
+  const auto start{ millis() };
+  do
+  {
+    rf.proceed();
+    if (rf.get_state() == RFStates::IDLE)
+    {
+      return true;
+    }
+  } while (millis() - start < 2 * RF_SEND_TIMEOUT_MS);
+
+  return false;
+}
+
+/**
+ * @test Set up function for the tests
+ */
+void setUp(void)
+{
+  // set stuff up here
+}
+
+/**
+ * @test Tear down function for the tests
+ */
+void tearDown(void)
+{
+  // clean stuff up here
+}
+
+/**
+ * @test Test the size of the packed payload
+ */
+void test_payload_size(void)
+{
+  TEST_ASSERT_EQUAL(3 * sizeof(int16_t), sizeof(PayloadTx_struct<>));
+  TEST_ASSERT_EQUAL(5 * sizeof(int16_t), sizeof(payload));
+}
+
+/**
+ * @test Test the configuration getters
+ */
+void test_configuration(void)
+{
+  TEST_ASSERT_EQUAL(10, rf.get_nodeID());
+  TEST_ASSERT_EQUAL(210, rf.get_networkGroup());
+  TEST_ASSERT_TRUE(RFStates::IDLE == rf.get_state());
+}
+
+/**
+ * @test Test that a payload waiting for the channel is replaced by a newer one
+ */
+void test_queue_replaces_waiting_payload(void)
+{
+  const auto dropped{ rf.get_dropped() };
+
+  rf.queue(payload);
+  TEST_ASSERT_TRUE(RFStates::WAITING == rf.get_state());
+
+  rf.queue(payload);
+  TEST_ASSERT_EQUAL(dropped + 1, rf.get_dropped());
+
+  TEST_ASSERT_TRUE(sendPayload());
+}
+
+/**
+ * @test Test sending a packet
+ */
+void test_send(void)
+{
+  const auto sent{ rf.get_sent() };
+
+  TEST_ASSERT_TRUE(sendPayload());
+  TEST_ASSERT_EQUAL(sent + 1, rf.get_sent());
+}
+
+/**
+ * @test Test that no ADC sample is lost while a packet is in flight
+ * @details If the ADC interrupt is delayed by more than one conversion, a sample is overwritten.
+ */
+void test_adc_latency_while_sending(void)
+{
+  resetADC_stats();
+
+  for (uint8_t i = 0; i < 10; ++i)
+  {
+    TEST_ASSERT_TRUE(sendPayload());
+  }
+
+  TEST_ASSERT_GREATER_THAN(0, countADC);
+  TEST_ASSERT_LESS_THAN(ADC_PERIOD_IN_TICKS + ADC_PERIOD_IN_TICKS / 2, maxADC_interval);
+}
+
+void setup()
+{
+  delay(1000);
+
+  // Timer1 in normal mode, clk/8 => 0.5 µs per tick
+  TCCR1A = 0;
+  TCCR1B = bit(CS11);
+
+  // ADC in free-running mode, same settings as the router
+  ADMUX = bit(REFS0);
+  ADCSRB = 0;
+  ADCSRA = bit(ADPS0) | bit(ADPS1) | bit(ADPS2) | bit(ADATE) | bit(ADIE) | bit(ADEN);
+  ADCSRA |= bit(ADSC);
+
+  rf.initialize();
+
+  UNITY_BEGIN();  // IMPORTANT LINE!
+}
+
+void loop()
+{
+  RUN_TEST(test_payload_size);
+  RUN_TEST(test_configuration);
+
+  RUN_TEST(test_send);
+  RUN_TEST(test_queue_replaces_waiting_payload);
+
+  RUN_TEST(test_adc_latency_while_sending);
+
+  UNITY_END();  // stop unit testing
+}
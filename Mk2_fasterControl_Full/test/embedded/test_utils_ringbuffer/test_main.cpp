@@ -0,0 +1,133 @@
+/**
+ * @file test_main.cpp
+ * @author Frederic Metrich (frederic.metrich@live.fr)
+ * @test Target tests for the SPSC ring buffer
+ * @version 0.1
+ * @date 2024-12-10
+ *
+ * @copyright Copyright (c) 2024
+ *
+ * @note Pushes from the Timer1 interrupt while loop() pops.
+ *       The behaviour of the buffer itself is tested on the host (test/native/test_utils_ringbuffer).
+ *
+ */
+
+#include <Arduino.h>
+
+#include <unity.h>
+
+#include "utils_ringbuffer.h"
+
+constexpr uint16_t ISR_ELEMENTS{ 2000 };   /**< number of elements pushed from the ISR */
+constexpr uint32_t ISR_TIMEOUT_MS{ 5000 }; /**< time allowed for the ISR test */
+
+RingBuffer< uint8_t, 8 > isrBuffer; /**< filled by the Timer1 interrupt */
+volatile uint16_t isrPushed{ 0 };   /**< elements pushed by the interrupt, dropped ones included */
+volatile uint8_t isrNext{ 0 };      /**< next value to push from the interrupt */
+
+/**
+ * @test Producer for the ISR test: pushes a sequence of values, retries a value while the buffer is full
+ */
+ISR(TIMER1_COMPA_vect)
+{
+  if (isrPushed >= ISR_ELEMENTS)
+  {
+    return;
+  }
+  if (isrBuffer.push(isrNext))
+  {
+    ++isrNext;
+  }
+  ++isrPushed;
+}
+
+/**
+ * @brief Read the number of elements pushed by the interrupt
+ * @details The 16-bit counter is read with interrupts disabled, so that it's never torn.
+ *
+ */
+uint16_t getIsrPushed()
+{
+  const uint8_t oldSREG{ SREG };
+  cli();
+  const uint16_t pushed{ isrPushed };
+  SREG = oldSREG;
+
+  return pushed;
+}
+
+/**
+ * @test Set up function for the tests
+ */
+void setUp(void)
+{
+  // set stuff up here
+}
+
+/**
+ * @test Tear down function for the tests
+ */
+void tearDown(void)
+{
+  // clean stuff up here
+}
+
+/**
+ * @test Push from the Timer1 interrupt, pop from loop(): no element is lost, duplicated or reordered
+ */
+void test_isr_producer(void)
+{
+  uint8_t expected{ 0 };
+  uint8_t value;
+
+  // Timer1 in CTC mode at 20 kHz, about the rate of the ADC interrupt
+  cli();
+  TCCR1A = 0;
+  TCCR1B = bit(WGM12) | bit(CS10);
+  OCR1A = F_CPU / 20000 - 1;
+  TIMSK1 = bit(OCIE1A);
+  sei();
+
+  const uint32_t start{ millis() };
+  while (getIsrPushed() < ISR_ELEMENTS || !isrBuffer.empty())
+  {
+    if (isrBuffer.pop(value))
+    {
+      TEST_ASSERT_EQUAL(expected, value);
+      ++expected;
+    }
+    if (random(4) == 0)
+    {
+      delayMicroseconds(random(200));  // the consumer is late from time to time
+    }
+    if (millis() - start > ISR_TIMEOUT_MS)
+    {
+      break;
+    }
+  }
+
+  TIMSK1 = 0;
+
+  TEST_ASSERT_EQUAL(isrNext, expected);
+  TEST_ASSERT_EQUAL(ISR_ELEMENTS, isrPushed);  // the interrupt is disabled
+}
+
+/**
+ * @test Setup function for the test environment
+ */
+void setup()
+{
+  delay(1000);
+
+  UNITY_BEGIN();  // IMPORTANT LINE!
+}
+
+/**
+ * @test Loop function for running the tests
+ */
+void loop()
+{
+  RUN_TEST(test_isr_producer);
+
+  UNITY_END();  // stop unit testing
+}
@@ -0,0 +1,188 @@
+/**
+ * @file test_main.cpp
+ * @author Frederic Metrich (frederic.metrich@live.fr)
+ * @brief Tests for the non-blocking I2C output of the OLED display
+ * @version 0.1
+ * @date 2024-12-01
+ *
+ * @copyright Copyright (c) 2024
+ *
+ * @note These tests need a SSD1306 OLED display connected to the board (A4/A5).
+ *       The ADC runs free like in the router, and the interval between two ADC interrupts
+ *       is measured with Timer1 while the whole screen is redrawn.
+ *
+ */
+
+#include <Arduino.h>
+#include <U8g2lib.h>
+
+#include <unity.h>
+
+#include "utils_twi.h"
+
+U8X8_SSD1306_128X64_NONAME_ASYNC_I2C u8x8;
+
+constexpr uint16_t ADC_PERIOD_IN_TICKS{ 13 * 128 / 8 }; /**< one ADC conversion (104 µs) in Timer1 ticks (0.5 µs) */
+
+volatile uint16_t lastADC_tick{ 0 };
+volatile uint16_t maxADC_interval{ 0 };
+volatile uint16_t countADC{ 0 };
+
+/**
+ * @brief Send the next byte to the display
+ *
+ */
+ISR(TWI_vect)
+{
+  AsyncTWI::proceed();
+}
+
+/**
+ * @brief Measure the interval between 2 ADC interrupts
+ *
+ */
+ISR(ADC_vect)
+{
+  const uint16_t now{ TCNT1 };
+  const uint16_t interval{ static_cast< uint16_t >(now - lastADC_tick) };
+
+  lastADC_tick = now;
+  ++countADC;
+
+  if (interval > maxADC_interval)
+  {
+    maxADC_interval = interval;
+  }
+}
+
+/**
+ * @brief Reset the measurement
+ *
+ */
+void resetADC_stats()
+{
+  noInterrupts();
+  lastADC_tick = TCNT1;
+  maxADC_interval = 0;
+  countADC = 0;
+  interrupts();
+}
+
+/**
+ * @brief Wait until all queued transfers have been sent
+ *
+ * @return true if the output went idle in time
+ */
+bool waitIdle()
+{
+  const auto start{ millis() };
+  do
+  {
+    if (AsyncTWI::idle())
+    {
+      return true;
+    }
+  } while (millis() - start < 200);
+
+  return false;
+}
+
+/**
+ * @test Set up function for the tests
+ */
+void setUp(void)
+{
+  // set stuff up here
+}
+
+/**
+ * @test Tear down function for the tests
+ */
+void tearDown(void)
+{
+  // clean stuff up here
+}
+
+/**
+ * @test Test that the display acknowledges the transfers
+ */
+void test_no_error(void)
+{
+  u8x8.clearDisplay();
+
+  TEST_ASSERT_TRUE(waitIdle());
+  TEST_ASSERT_EQUAL(0, AsyncTWI::get_errors());
+}
+
+/**
+ * @test Test that drawing returns before the data has been sent
+ */
+void test_update_does_not_block(void)
+{
+  TEST_ASSERT_TRUE(waitIdle());
+
+  u8x8.setFont(u8x8_font_inb33_3x6_n);
+
+  const auto start{ micros() };
+  u8x8.drawGlyph(0, 0, '8');
+  const auto returned{ micros() - start };
+
+  TEST_ASSERT_FALSE(AsyncTWI::idle());
+  TEST_ASSERT_TRUE(waitIdle());
+  const auto sent{ micros() - start };
+
+  // only the part which does not fit in the ring buffer is waited for
+  TEST_ASSERT_LESS_THAN(sent, returned);
+}
+
+/**
+ * @test Test that no ADC sample is lost during a full-screen redraw
+ * @details If the ADC interrupt is delayed by more than one conversion, a sample is overwritten.
+ */
+void test_adc_latency_during_full_redraw(void)
+{
+  u8x8.setFont(u8x8_font_7x14B_1x2_r);
+
+  resetADC_stats();
+
+  for (uint8_t i = 0; i < 5; ++i)
+  {
+    u8x8.clearDisplay();
+    for (uint8_t row = 0; row < 8; row += 2)
+    {
+      u8x8.drawString(0, row, "0123456789ABCDEF");
+    }
+  }
+  TEST_ASSERT_TRUE(waitIdle());
+
+  TEST_ASSERT_GREATER_THAN(0, countADC);
+  TEST_ASSERT_LESS_THAN(ADC_PERIOD_IN_TICKS + ADC_PERIOD_IN_TICKS / 2, maxADC_interval);
+}
+
+void setup()
+{
+  delay(1000);
+
+  // Timer1 in normal mode, clk/8 => 0.5 µs per tick
+  TCCR1A = 0;
+  TCCR1B = bit(CS11);
+
+  // ADC in free-running mode, same settings as the router
+  ADMUX = bit(REFS0);
+  ADCSRB = 0;
+  ADCSRA = bit(ADPS0) | bit(ADPS1) | bit(ADPS2) | bit(ADATE) | bit(ADIE) | bit(ADEN);
+  ADCSRA |= bit(ADSC);
+
+  u8x8.begin();
+
+  UNITY_BEGIN();  // IMPORTANT LINE!
+}
+
+void loop()
+{
+  RUN_TEST(test_no_error);
+  RUN_TEST(test_update_does_not_block);
+  RUN_TEST(test_adc_latency_during_full_redraw);
+
+  UNITY_END();  // stop unit testing
+}
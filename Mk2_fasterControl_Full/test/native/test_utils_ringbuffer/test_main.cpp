@@ -0,0 +1,211 @@
+/**
+ * @file test_main.cpp
+ * @author Frederic Metrich (frederic.metrich@live.fr)
+ * @test Host tests for the SPSC ring buffer
+ * @version 0.1
+ * @date 2024-12-10
+ *
+ * @copyright Copyright (c) 2024
+ *
+ * @note Run on the host with 'pio test -e native'. The interrupt-driven producer is tested
+ *       on the target (test/embedded/test_utils_ringbuffer).
+ *       The interleavings are drawn from a fixed seed, so a failure can be replayed.
+ *
+ */
+
+#include <stdint.h>
+
+#include <unity.h>
+
+#include "utils_ringbuffer.h"
+
+constexpr uint16_t RANDOM_STEPS{ 50000 }; /**< number of random push/pop steps */
+
+uint32_t seed{ 1 }; /**< state of the pseudo-random generator */
+
+/**
+ * @brief Pseudo-random number, the same sequence on every host
+ *
+ * @param max Upper bound (excluded)
+ * @return uint32_t A number in [0, max)
+ */
+uint32_t nextRandom(uint32_t max)
+{
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed % max;
+}
+
+/**
+ * @test Set up function for the tests
+ */
+void setUp(void)
+{
+  // set stuff up here
+}
+
+/**
+ * @test Tear down function for the tests
+ */
+void tearDown(void)
+{
+  // clean stuff up here
+}
+
+/**
+ * @test Test an empty buffer
+ */
+void test_empty(void)
+{
+  RingBuffer< uint8_t, 4 > buffer;
+  uint8_t value{ 42 };
+
+  TEST_ASSERT_TRUE(buffer.empty());
+  TEST_ASSERT_EQUAL(0, buffer.size());
+  TEST_ASSERT_EQUAL(4, buffer.capacity());
+  TEST_ASSERT_FALSE(buffer.pop(value));
+  TEST_ASSERT_EQUAL(42, value);
+}
+
+/**
+ * @test Test the FIFO order
+ */
+void test_fifo_order(void)
+{
+  RingBuffer< uint16_t, 4 > buffer;
+  uint16_t value;
+
+  TEST_ASSERT_TRUE(buffer.push(1000));
+  TEST_ASSERT_TRUE(buffer.push(2000));
+  TEST_ASSERT_TRUE(buffer.push(3000));
+  TEST_ASSERT_EQUAL(3, buffer.size());
+
+  TEST_ASSERT_TRUE(buffer.pop(value));
+  TEST_ASSERT_EQUAL(1000, value);
+  TEST_ASSERT_TRUE(buffer.pop(value));
+  TEST_ASSERT_EQUAL(2000, value);
+  TEST_ASSERT_TRUE(buffer.pop(value));
+  TEST_ASSERT_EQUAL(3000, value);
+  TEST_ASSERT_TRUE(buffer.empty());
+}
+
+/**
+ * @test Test a full buffer and the overflow counter
+ */
+void test_overflow(void)
+{
+  RingBuffer< uint8_t, 4 > buffer;
+  uint8_t value;
+
+  for (uint8_t i = 0; i < 4; ++i)
+  {
+    TEST_ASSERT_TRUE(buffer.push(i));
+  }
+  TEST_ASSERT_FALSE(buffer.push(4));
+  TEST_ASSERT_FALSE(buffer.push(5));
+  TEST_ASSERT_EQUAL(2, buffer.get_overflows());
+  TEST_ASSERT_EQUAL(4, buffer.size());
+
+  // the dropped elements are the new ones
+  TEST_ASSERT_TRUE(buffer.pop(value));
+  TEST_ASSERT_EQUAL(0, value);
+  TEST_ASSERT_TRUE(buffer.push(6));
+  TEST_ASSERT_EQUAL(2, buffer.get_overflows());
+
+  for (uint16_t i = 0; i < 300; ++i)
+  {
+    buffer.push(0);
+  }
+  TEST_ASSERT_EQUAL(UINT8_MAX, buffer.get_overflows());
+}
+
+/**
+ * @test Test the wrap-around of the 8-bit indices
+ */
+void test_index_wrap(void)
+{
+  RingBuffer< uint16_t, 128 > buffer;
+  uint16_t value;
+
+  for (uint16_t i = 0; i < 1000; ++i)
+  {
+    TEST_ASSERT_TRUE(buffer.push(i));
+    if (i >= 100)
+    {
+      TEST_ASSERT_TRUE(buffer.pop(value));
+      TEST_ASSERT_EQUAL(i - 100, value);
+    }
+    TEST_ASSERT_EQUAL(i < 100 ? i + 1 : 100, buffer.size());
+  }
+  TEST_ASSERT_EQUAL(0, buffer.get_overflows());
+}
+
+/**
+ * @test Random interleavings of push and pop against a reference model
+ */
+void test_random_interleavings(void)
+{
+  RingBuffer< uint8_t, 16 > buffer;
+  uint8_t model[256];
+  uint8_t modelHead{ 0 };
+  uint8_t modelTail{ 0 };
+  uint8_t expectedOverflows{ 0 };
+  uint8_t value;
+
+  seed = 0x5EED;
+
+  for (uint16_t step = 0; step < RANDOM_STEPS; ++step)
+  {
+    // bursts on either side, like a late loop() or a busy ISR
+    const bool producer{ nextRandom(100) < (step & 0x100 ? 70 : 30) };
+    const uint8_t burst{ static_cast< uint8_t >(1 + nextRandom(5)) };
+
+    for (uint8_t i = 0; i < burst; ++i)
+    {
+      if (producer)
+      {
+        const auto newValue{ static_cast< uint8_t >(nextRandom(256)) };
+        const bool full{ static_cast< uint8_t >(modelHead - modelTail) >= buffer.capacity() };
+
+        TEST_ASSERT_EQUAL(!full, buffer.push(newValue));
+        if (!full)
+        {
+          model[modelHead++] = newValue;
+        }
+        else if (expectedOverflows != UINT8_MAX)
+        {
+          ++expectedOverflows;  // the counter saturates
+        }
+      }
+      else
+      {
+        const bool empty{ modelHead == modelTail };
+
+        TEST_ASSERT_EQUAL(!empty, buffer.pop(value));
+        if (!empty)
+        {
+          TEST_ASSERT_EQUAL(model[modelTail++], value);
+        }
+      }
+      TEST_ASSERT_EQUAL(static_cast< uint8_t >(modelHead - modelTail), buffer.size());
+    }
+  }
+  TEST_ASSERT_EQUAL(expectedOverflows, buffer.get_overflows());
+}
+
+/**
+ * @test Entry point of the host tests
+ */
+int main()
+{
+  UNITY_BEGIN();
+
+  RUN_TEST(test_empty);
+  RUN_TEST(test_fifo_order);
+  RUN_TEST(test_overflow);
+  RUN_TEST(test_index_wrap);
+  RUN_TEST(test_random_interleavings);
+
+  return UNITY_END();
+}
@@ -54,6 +54,19 @@ enum class RotationModes : uint8_t
   PIN   /**< Pin triggered */
 };
 
+/** Events sent by the ISR to loop() */
+enum class IsrEvents : uint8_t
+{
+  DATALOG,      /**< the data of a datalog period are available */
+  LOADS_ROTATED /**< the load priorities have been rotated (ControlCommands::ROTATE_LOADS) */
+};
+
+/** Commands sent by loop() to the ISR */
+enum class ControlCommands : uint8_t
+{
+  ROTATE_LOADS /**< rotate the load priorities */
+};
+
 /** Display type */
 enum class DisplayType : uint8_t
 {
@@ -63,12 +76,21 @@ enum class DisplayType : uint8_t
   SEG_HW, /**< 7-segments with Pin saving hardware */
 };
 
+/** Frequency bands of the RFM12B module (same values as JeeLib) */
+enum class RFBands : uint8_t
+{
+  RF_433MHZ = 1, /**< 433 MHz */
+  RF_868MHZ = 2, /**< 868 MHz */
+  RF_915MHZ = 3  /**< 915 MHz */
+};
+
 /** @brief Container for datalogging
  *  @details This class is used for datalogging.
+ *           It is also the RF payload, hence packed: the layout is the same on all platforms.
  *
  * @tparam S # of temperature sensors
  */
-template< uint8_t S = 0 > class PayloadTx_struct
+template< uint8_t S = 0 > class __attribute__((packed)) PayloadTx_struct
 {
 public:
   int16_t powerGrid;           /**< main power, import = +ve, to match OEM convention */
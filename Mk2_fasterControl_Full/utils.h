@@ -16,6 +16,11 @@
 #include "constants.h"
 #include "dualtariff.h"
 #include "processing.h"
+#include "utils_bcd.h"
+#include "utils_energy.h"
+#include "utils_json.h"
+#include "utils_serial.h"
+#include "utils_settings.h"
 
 #include "FastDivision.h"
 
@@ -57,98 +62,421 @@ inline void printConfiguration()
 #endif
   DBUGLN(F("ADC mode:       free-running"));
 
-  DBUGLN(F("Electrical settings"));
+  DBUG(F("Electrical settings"));
+  DBUGLN(settingsStore.is_fromEEPROM() ? F(" (from EEPROM)") : F(" (defaults)"));
 
   DBUG(F("\tf_powerCal for Grid"));
   DBUG(F(" =    "));
-  DBUGLN(powerCal_grid, 6);
+  DBUGLN(settings.gridPowerCal, 6);
   DBUG(F("\tf_powerCal for Diversion"));
   DBUG(F(" =    "));
-  DBUGLN(powerCal_diverted, 6);
+  DBUGLN(settings.divertedPowerCal, 6);
+  DBUG(F("\tf_voltageCal"));
+  DBUG(F(" =    "));
+  DBUGLN(settings.voltageCal, 6);
 
   DBUG("\tAnti-creep limit (Joules / mains cycle) = ");
-  DBUGLN(ANTI_CREEP_LIMIT);
+  DBUGLN(settings.antiCreepLimit_J);
   DBUG("\tExport rate (Watts) = ");
-  DBUGLN(REQUIRED_EXPORT_IN_WATTS);
+  DBUGLN(settings.requiredExport_W);
+  DBUG("\tWorking zone (Joules) = ");
+  DBUGLN(settings.workingZone_J);
+
+  if constexpr (RF_CHIP_PRESENT)
+  {
+    rf.printConfiguration();
+  }
 
   printParamsForSelectedOutputMode();
 }
 
+inline constexpr uint8_t PRIORITY_LINE_LENGTH{ 20 }; /**< longest line of the load priorities */
+
+inline uint8_t loadPrioritiesLinesToPrint{ 0 }; /**< lines of the load priorities not yet printed */
+
 /**
  * @brief Prints the load priorities to the Serial output.
+ * @details Nothing is printed here, the lines are printed by proceedLoadPriorities().
+ *          If the previous list is not complete yet, it starts again with the new priorities.
  *
  */
 inline void logLoadPriorities()
 {
 #ifdef ENABLE_DEBUG
+  loadPrioritiesLinesToPrint = NO_OF_DUMPLOADS + 1;
+#endif
+}
 
-  DBUGLN(F("Load Priorities: "));
-  for (const auto& loadPrioAndState : loadPrioritiesAndState)
+/**
+ * @brief Print the next line of the load priorities
+ * @details To be called on each pass of loop(). A line is only printed when no other output
+ *          is pending and the UART buffer can take it without blocking.
+ *
+ */
+inline void proceedLoadPriorities()
+{
+#ifdef ENABLE_DEBUG
+  if (!loadPrioritiesLinesToPrint || SerialTxQueueBase::size() || Serial.availableForWrite() < PRIORITY_LINE_LENGTH + TX_RESERVED_ROOM)
   {
-    DBUG(F("\tload "));
-    DBUGLN(loadPrioAndState);
+    return;
   }
 
+  const uint8_t idx{ static_cast< uint8_t >(NO_OF_DUMPLOADS + 1 - loadPrioritiesLinesToPrint--) };
+  if (!idx)
+  {
+    DBUGLN(F("Load Priorities: "));
+  }
+  else
+  {
+    DBUG(F("\tload "));
+    DBUGLN(loadPrioritiesAndState[idx - 1]);
+  }
 #endif
 }
 
+inline constexpr uint8_t STACK_CANARY{ 0xC5 }; /**< pattern painted over the free RAM at start-up, see paintStack() */
+
 /**
- * @brief Prints data logs to the Serial output in text format
+ * @brief Get the number of bytes of RAM never reached by the stack since start-up
+ * @details Counts the bytes above the static data still holding STACK_CANARY.
+ *          The ISRs run on the same stack, so their peak is included.
  *
+ * @return uint16_t The headroom of the stack, in bytes
  */
-inline void printForSerialText()
+inline uint16_t getStackUnused()
 {
-  Serial.print(copyOf_energyInBucket_long * invSUPPLY_FREQUENCY);
-  Serial.print(F(", P:"));
-  Serial.print(tx_data.powerGrid);
+  extern uint8_t _end;
 
-  if constexpr (RELAY_DIVERSION)
+  const uint8_t *p{ &_end };
+  uint16_t count{ 0 };
+  while (*p++ == STACK_CANARY)
+  {
+    ++count;
+  }
+  return count;
+}
+
+inline uint16_t maxLoopLatency_cycles{ 0 }; /**< largest number of mains cycles between two passes of loop() over the datalog period, 1 when none is missed */
+
+/**
+ * @brief Snapshot of the data logs, queued for the Serial output in text or json format
+ *
+ */
+struct TelemetryRecord
+{
+  decltype(tx_data) data;                     /**< copy of the logging data */
+  int32_t energyInBucket_long;                /**< copy of the energy bucket */
+  int32_t relayAverage;                       /**< relay sliding average */
+  uint32_t absenceOfDivertedEnergyCount;      /**< number of mains cycles without diverted energy */
+  uint16_t divertedEnergyTotal_Wh;            /**< diverted energy */
+  uint32_t importedEnergy_Wh;                 /**< energy imported today */
+  uint32_t exportedEnergy_Wh;                 /**< energy exported today */
+  uint16_t sampleSetsDuringThisDatalogPeriod; /**< number of sample sets during the datalog period */
+  uint16_t countLoadON[NO_OF_DUMPLOADS];      /**< number of mains cycles each load was ON */
+  uint16_t maxLoopLatency_cycles;             /**< largest number of mains cycles between two passes of loop() */
+  uint8_t lowestNoOfSampleSetsPerMainsCycle;  /**< lowest number of sample sets per mains cycle */
+  bool json;                                  /**< true for json format, false for text format */
+
+  /**
+   * @brief Print one field of the record
+   *
+   * @param idx The index of the field
+   * @param out The output
+   * @return true if the field has been printed
+   * @return false if there's no more field
+   */
+  bool printField(uint8_t idx, Print &out) const
   {
-    Serial.print(F("/"));
-    Serial.print(relays.get_average());
+    return json ? printJsonField(idx, out) : printTextField(idx, out);
   }
 
-  Serial.print(F(", D:"));
-  Serial.print(tx_data.powerDiverted);
+  /**
+   * @brief Print one field of the record in json format
+   * @details The json document is produced in several pieces, one per field.
+   *
+   * @param idx The index of the field
+   * @param out The output
+   * @return true if the field has been printed
+   * @return false if there's no more field
+   */
+  bool printJsonField(uint8_t idx, Print &out) const
+  {
+    constexpr uint8_t LOAD_FIELDS_START{ 7 };
+    constexpr uint8_t LOAD_FIELDS_END{ LOAD_FIELDS_START + NO_OF_DUMPLOADS };
+    constexpr uint8_t TEMP_FIELDS_START{ LOAD_FIELDS_END + 2 };
+    constexpr uint8_t TEMP_FIELDS_COUNT{ TEMP_SENSOR_PRESENT ? temperatureSensing.get_size() : 0 };
 
-  Serial.print(F(", E:"));
-  Serial.print((float)divertedEnergyTotal_Wh * 0.001F, 3);
+    if (idx >= LOAD_FIELDS_START && idx < LOAD_FIELDS_END)
+    {
+      const uint8_t loadIdx = idx - LOAD_FIELDS_START;
+      JsonWriter{ out, loadIdx != 0 }.value(countLoadON[loadIdx]);
+      return true;
+    }
 
-  Serial.print(F(", V"));
-  Serial.print(F(":"));
-  Serial.print((float)tx_data.Vrms_L_x100 * 0.01F);
+    if (idx >= TEMP_FIELDS_START && idx < TEMP_FIELDS_START + TEMP_FIELDS_COUNT)
+    {
+      const uint8_t tempIdx = idx - TEMP_FIELDS_START;
+      const auto temperature_x100{ data.temperature_x100[tempIdx] };
+      JsonWriter json{ out, tempIdx != 0 };
 
-  if constexpr (TEMP_SENSOR_PRESENT)
+      if ((OUTOFRANGE_TEMPERATURE == temperature_x100) || (DEVICE_DISCONNECTED_RAW == temperature_x100))
+      {
+        json.null();
+      }
+      else
+      {
+        json.value_x100(temperature_x100);
+      }
+      return true;
+    }
+
+    JsonWriter json{ out, idx != 0 };
+
+    switch (idx)
+    {
+      case 0:
+        json.beginObject();
+        json.member(F("grid"), data.powerGrid);
+        return true;
+      case 1:
+        json.member(F("diverted"), data.powerDiverted);
+        return true;
+      case 2:
+        json.member(F("energy_Wh"), divertedEnergyTotal_Wh);
+        return true;
+      case 3:
+        json.member(F("import_Wh"), static_cast< int32_t >(importedEnergy_Wh));
+        return true;
+      case 4:
+        json.member(F("export_Wh"), static_cast< int32_t >(exportedEnergy_Wh));
+        return true;
+      case 5:
+        json.member_x100(F("Vrms"), data.Vrms_L_x100);
+        return true;
+      case 6:
+        json.beginArray(F("loadON"));
+        return true;
+      case LOAD_FIELDS_END:
+        json.endArray();
+        if constexpr (RELAY_DIVERSION)
+        {
+          json.member(F("relayAvg"), relayAverage);
+        }
+        return true;
+      case LOAD_FIELDS_END + 1:
+        if constexpr (TEMP_SENSOR_PRESENT)
+        {
+          json.beginArray(F("T"));
+        }
+        return true;
+      case TEMP_FIELDS_START + TEMP_FIELDS_COUNT:
+        if constexpr (TEMP_SENSOR_PRESENT)
+        {
+          json.endArray();
+        }
+        json.endObject();
+        out.println();
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  /**
+   * @brief Print one field of the record in text format
+   *
+   * @param idx The index of the field
+   * @param out The output
+   * @return true if the field has been printed
+   * @return false if there's no more field
+   */
+  bool printTextField(uint8_t idx, Print &out) const
   {
-    for (uint8_t idx = 0; idx < temperatureSensing.get_size(); ++idx)
+    constexpr uint8_t TEMP_FIELDS_START{ 7 };
+    constexpr uint8_t TEMP_FIELDS_COUNT{ TEMP_SENSOR_PRESENT ? temperatureSensing.get_size() : 0 };
+
+    if (idx >= TEMP_FIELDS_START && idx < TEMP_FIELDS_START + TEMP_FIELDS_COUNT)
     {
-      if ((OUTOFRANGE_TEMPERATURE == tx_data.temperature_x100[idx])
-          || (DEVICE_DISCONNECTED_RAW == tx_data.temperature_x100[idx]))
+      const uint8_t tempIdx = idx - TEMP_FIELDS_START;
+      const auto temperature_x100{ data.temperature_x100[tempIdx] };
+
+      if ((OUTOFRANGE_TEMPERATURE != temperature_x100) && (DEVICE_DISCONNECTED_RAW != temperature_x100))
       {
-        continue;
+        out.print(F(", T"));
+        out.print(tempIdx + 1);
+        out.print(F(":"));
+        printFixedPoint(out, temperature_x100, 2);
       }
+      return true;
+    }
+
+    if (idx >= TEMP_FIELDS_START)
+    {
+      idx -= TEMP_FIELDS_COUNT;
+    }
 
-      Serial.print(F(", T"));
-      Serial.print(idx + 1);
-      Serial.print(F(":"));
-      Serial.print((float)tx_data.temperature_x100[idx] * 0.01F);
+    switch (idx)
+    {
+      case 0:
+        out.print(energyInBucket_long * invSUPPLY_FREQUENCY);
+        out.print(F(", P:"));
+        out.print(data.powerGrid);
+        return true;
+      case 1:
+        if constexpr (RELAY_DIVERSION)
+        {
+          out.print(F("/"));
+          out.print(relayAverage);
+        }
+        return true;
+      case 2:
+        out.print(F(", D:"));
+        out.print(data.powerDiverted);
+        return true;
+      case 3:
+        out.print(F(", E:"));
+        printFixedPoint(out, divertedEnergyTotal_Wh, 3);
+        return true;
+      case 4:
+        out.print(F(", Imp(Wh):"));
+        out.print(importedEnergy_Wh);
+        return true;
+      case 5:
+        out.print(F(", Exp(Wh):"));
+        out.print(exportedEnergy_Wh);
+        return true;
+      case 6:
+        out.print(F(", V:"));
+        printFixedPoint(out, data.Vrms_L_x100, 2);
+        return true;
+      case TEMP_FIELDS_START:
+        out.print(F(", (minSampleSets/MC "));
+        out.print(lowestNoOfSampleSetsPerMainsCycle);
+        return true;
+      case TEMP_FIELDS_START + 1:
+        out.print(F(", #ofSampleSets "));
+        out.print(sampleSetsDuringThisDatalogPeriod);
+        return true;
+      case TEMP_FIELDS_START + 2:
+        if constexpr (PRIORITY_ROTATION != RotationModes::OFF)
+        {
+          out.print(F(", NoED "));
+          out.print(absenceOfDivertedEnergyCount);
+        }
+        return true;
+      case TEMP_FIELDS_START + 3:
+        if (SerialTxQueueBase::get_droppedTelemetry() || SerialTxQueueBase::get_droppedDebug())
+        {
+          out.print(F(", TxDrop "));
+          out.print(SerialTxQueueBase::get_droppedTelemetry());
+          out.print(F("/"));
+          out.print(SerialTxQueueBase::get_droppedDebug());
+        }
+        return true;
+      case TEMP_FIELDS_START + 4:
+        if constexpr (TEMP_SENSOR_PRESENT)
+        {
+          out.print(F(", OW "));
+          out.print(temperatureSensing.get_maxStepDuration());
+          out.print(F("/"));
+          out.print(temperatureSensing.get_readDuration());
+          out.print(F("us"));
+        }
+        return true;
+      case TEMP_FIELDS_START + 5:
+        out.print(F(", StackFree "));
+        out.print(getStackUnused());
+        return true;
+      case TEMP_FIELDS_START + 6:
+        out.print(F(", EvOvf "));
+        out.print(isrEvents.get_overflows());
+        out.print('/');
+        out.print(controlCommands.get_overflows());
+        return true;
+      case TEMP_FIELDS_START + 7:
+        out.print(F(", LoopLat "));
+        out.print(maxLoopLatency_cycles);
+        return true;
+      case TEMP_FIELDS_START + 8:
+        out.print(F(", TxHWM "));
+        out.print(SerialTxQueueBase::get_highWatermark());
+        out.println(F(")"));
+        return true;
+      default:
+        return false;
     }
   }
+};
 
-  Serial.print(F(", (minSampleSets/MC "));
-  Serial.print(copyOf_lowestNoOfSampleSetsPerMainsCycle);
-  Serial.print(F(", #ofSampleSets "));
-  Serial.print(copyOf_sampleSetsDuringThisDatalogPeriod);
+inline SerialTxQueue< TelemetryRecord > serialTxQueue; /**< non-blocking queue for the Serial output */
+
+/**
+ * @brief Take a snapshot of the data logs and queue it for the Serial output
+ * @details The text is produced later by serialTxQueue.pump() as the UART frees space,
+ *          so loop() is never blocked.
+ *
+ * @param json true for json format, false for text format
+ */
+inline void queueTelemetry(bool json)
+{
+  TelemetryRecord rec{};
+
+  rec.data = tx_data;
+  rec.energyInBucket_long = copyOf_energyInBucket_long;
+  rec.divertedEnergyTotal_Wh = divertedEnergyTotal_Wh;
+  rec.importedEnergy_Wh = energyCounters.get_today().imported_Wh;
+  rec.exportedEnergy_Wh = energyCounters.get_today().exported_Wh;
+  rec.sampleSetsDuringThisDatalogPeriod = copyOf_sampleSetsDuringThisDatalogPeriod;
+  rec.lowestNoOfSampleSetsPerMainsCycle = copyOf_lowestNoOfSampleSetsPerMainsCycle;
+  rec.maxLoopLatency_cycles = maxLoopLatency_cycles;
+  rec.absenceOfDivertedEnergyCount = absenceOfDivertedEnergyCount;
+  rec.json = json;
+
+  uint8_t i{ NO_OF_DUMPLOADS };
+  do
+  {
+    --i;
+    rec.countLoadON[i] = copyOf_countLoadON[i];
+  } while (i);
 
-#ifndef DUAL_TARIFF
-  if constexpr (PRIORITY_ROTATION != RotationModes::OFF)
+  if constexpr (RELAY_DIVERSION)
   {
-    Serial.print(F(", NoED "));
-    Serial.print(absenceOfDivertedEnergyCount);
+    rec.relayAverage = relays.get_average();
   }
-#endif  // DUAL_TARIFF
 
-  Serial.println(F(")"));
+  serialTxQueue.push_telemetry(rec);
+}
+
+/**
+ * @brief Prints data logs to the Serial output in text format
+ *
+ */
+inline void printForSerialText()
+{
+  queueTelemetry(false);
+}
+
+/**
+ * @brief Prints data logs to the Serial output in json format
+ * @details Example: {"grid":-512,"diverted":1830,"energy_Wh":2150,"import_Wh":3120,"export_Wh":4870,"Vrms":231.45,"loadON":[250,0],"T":[52.25,null]}
+ *          'import_Wh' and 'export_Wh' are the energies imported from and exported to the grid today.
+          'loadON' is the number of mains cycles each load was ON during the datalog period.
+ *
+ */
+inline void printForSerialJson()
+{
+  queueTelemetry(true);
+}
+
+/**
+ * @brief Queues the data logs for the RF module
+ * @details The packet is sent from loop() as soon as the channel is free, see RFTransmitter.
+ *
+ * @ingroup RF
+ */
+inline void send_rf_data()
+{
+  rf.queue(tx_data);
 }
 
 /**
@@ -0,0 +1,151 @@
+/**
+ * @file utils_bcd.h
+ * @author Frédéric Metrich (frederic.metrich@live.fr)
+ * @brief Binary to BCD conversion and fixed-point printing
+ * @version 0.1
+ * @date 2024-11-29
+ *
+ * @copyright Copyright (c) 2024
+ *
+ * @section description Description
+ * The conversion uses the double-dabble algorithm (shift-and-add-3): the 16 bits of the
+ * value are shifted one by one into a 20-bit BCD register, and each BCD digit which is 5 or
+ * more is corrected with +3 before the shift. There's neither division nor multiplication,
+ * which the ATmega328P doesn't have in hardware for 16/32 bits.
+ *
+ * The resulting digits are used for the 7-segments display, the OLED display and the
+ * fixed-point values of the text datalog (no 'float' is involved anymore).
+ */
+
+#ifndef UTILS_BCD_H
+#define UTILS_BCD_H
+
+#include <Arduino.h>
+
+inline constexpr uint8_t BCD_DIGITS{ 5 }; /**< number of BCD digits of a 16-bit value */
+
+/**
+ * @brief Convert a 16-bit value to packed BCD
+ *
+ * @param value The value
+ * @return constexpr uint32_t The 5 BCD digits, 4 bits each, the units in the lowest nibble
+ */
+constexpr uint32_t bin2bcd(uint16_t value)
+{
+  uint8_t bcd[3]{ 0, 0, 0 };  // 2 digits per byte, units and tens in bcd[0]
+
+  uint8_t i{ 16 };
+  do
+  {
+    // add 3 to each digit >= 5, the shift below turns it into a decimal carry
+    for (uint8_t j = 0; j < 3; ++j)
+    {
+      if ((bcd[j] & 0x0F) >= 0x05)
+      {
+        bcd[j] += 0x03;
+      }
+      if ((bcd[j] & 0xF0) >= 0x50)
+      {
+        bcd[j] += 0x30;
+      }
+    }
+
+    // shift the next bit of the value into the BCD register
+    bcd[2] = (bcd[2] << 1) | (bcd[1] >> 7);
+    bcd[1] = (bcd[1] << 1) | (bcd[0] >> 7);
+    bcd[0] = (bcd[0] << 1) | (value >> 15);
+    value <<= 1;
+  } while (--i);
+
+  return (static_cast< uint32_t >(bcd[2]) << 16) | (static_cast< uint32_t >(bcd[1]) << 8) | bcd[0];
+}
+
+static_assert(bin2bcd(0) == 0x00000UL, "bin2bcd is broken !");
+static_assert(bin2bcd(9) == 0x00009UL, "bin2bcd is broken !");
+static_assert(bin2bcd(1234) == 0x01234UL, "bin2bcd is broken !");
+static_assert(bin2bcd(65535) == 0x65535UL, "bin2bcd is broken !");
+
+/**
+ * @brief Extract one digit of a packed BCD value
+ *
+ * @param bcd The packed BCD value
+ * @param pos The position of the digit (0 for the units)
+ * @return constexpr uint8_t The digit
+ */
+constexpr uint8_t bcdDigit(uint32_t bcd, uint8_t pos)
+{
+  return (bcd >> (pos << 2)) & 0x0F;
+}
+
+/**
+ * @brief Format a fixed-point value as a string
+ * @details 1234 with 3 decimals gives "1.234", 5 with 2 decimals gives "0.05".
+ *          At least one digit is written before the decimal point, there's no leading zero.
+ *
+ * @param buffer The output, at least BCD_DIGITS + 3 characters (sign, point and terminating null)
+ * @param value The value, scaled by 10^decimals
+ * @param decimals The number of decimals (0 to 4)
+ * @param negative true to write a minus sign
+ * @return uint8_t The length of the string
+ */
+inline uint8_t formatFixedPoint(char *buffer, uint16_t value, uint8_t decimals, bool negative = false)
+{
+  const uint32_t bcd{ bin2bcd(value) };
+  uint8_t len{ 0 };
+
+  if (negative)
+  {
+    buffer[len++] = '-';
+  }
+
+  uint8_t pos{ BCD_DIGITS };
+  while (pos > decimals + 1 && !bcdDigit(bcd, pos - 1))
+  {
+    --pos;  // skip the leading zeros
+  }
+
+  do
+  {
+    --pos;
+    buffer[len++] = '0' + bcdDigit(bcd, pos);
+    if (pos == decimals && pos)
+    {
+      buffer[len++] = '.';
+    }
+  } while (pos);
+
+  buffer[len] = '\0';
+  return len;
+}
+
+/**
+ * @brief Print a signed fixed-point value
+ *
+ * @param out The output
+ * @param value The value, scaled by 10^decimals
+ * @param decimals The number of decimals (0 to 4)
+ */
+inline void printFixedPoint(Print &out, int16_t value, uint8_t decimals)
+{
+  char buffer[BCD_DIGITS + 3];
+
+  formatFixedPoint(buffer, value < 0 ? static_cast< uint16_t >(0U - static_cast< uint16_t >(value)) : value, decimals, value < 0);
+  out.print(buffer);
+}
+
+/**
+ * @brief Print an unsigned fixed-point value
+ *
+ * @param out The output
+ * @param value The value, scaled by 10^decimals
+ * @param decimals The number of decimals (0 to 4)
+ */
+inline void printFixedPoint(Print &out, uint16_t value, uint8_t decimals)
+{
+  char buffer[BCD_DIGITS + 3];
+
+  formatFixedPoint(buffer, value, decimals);
+  out.print(buffer);
+}
+
+#endif /* UTILS_BCD_H */
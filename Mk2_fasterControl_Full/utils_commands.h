@@ -0,0 +1,619 @@
+/**
+ * @file utils_commands.h
+ * @author Frédéric Metrich (frederic.metrich@live.fr)
+ * @brief Commands received on the Serial input, for live tuning and diagnostics
+ * @version 0.1
+ * @date 2024-12-09
+ *
+ * @copyright Copyright (c) 2024
+ *
+ * @section description Description
+ * The characters are collected without waiting, at most COMMAND_INPUT_BUDGET per pass of loop(),
+ * into a fixed buffer. At most one command is executed per pass, at the end of its line.
+ * The answers are printed one line per pass, only when the Serial output is idle,
+ * so the commands never delay the display or the datalog.
+ *
+ * The names and the help of the commands, as well as the names of the settings, live in flash.
+ * Type "help" to list the commands.
+ */
+
+#ifndef UTILS_COMMANDS_H
+#define UTILS_COMMANDS_H
+
+#include <Arduino.h>
+
+#include "config.h"
+#include "processing.h"
+#include "utils_energy.h"
+#include "utils_pins.h"
+#include "utils_rtc.h"
+#include "utils_serial.h"
+#include "utils_settings.h"
+
+inline constexpr uint8_t COMMAND_BUFFER_SIZE{ 32 };      /**< longest command line + 1 */
+inline constexpr uint8_t COMMAND_INPUT_BUDGET{ 8 };      /**< characters read at most per pass of loop() */
+inline constexpr uint8_t ANSWER_LINE_LENGTH{ 40 };       /**< longest line of an answer */
+inline constexpr uint8_t SAMPLE_SETS_HISTORY_SIZE{ 16 }; /**< datalog periods kept in the history of lowestNoOfSampleSetsPerMainsCycle */
+
+/**
+ * @brief Type of a setting, for "get" and "set"
+ *
+ */
+enum class SettingTypes : uint8_t
+{
+  FLOAT,
+  INT16,
+  UINT16,
+  UINT8,
+};
+
+/**
+ * @brief Serial command interpreter
+ * @details All members are static: there's only one Serial input.
+ *
+ */
+class CommandInterpreter
+{
+public:
+  /**
+   * @brief Read the input and print the pending answer, to be called on each pass of loop()
+   *
+   */
+  static void proceed()
+  {
+    if (SerialTxQueueBase::size() || Serial.availableForWrite() < ANSWER_LINE_LENGTH + TX_RESERVED_ROOM)
+    {
+      return;
+    }
+
+    if (lister)
+    {
+      if (!lister(listIndex++))
+      {
+        lister = nullptr;
+      }
+      return;
+    }
+
+    uint8_t budget{ COMMAND_INPUT_BUDGET };
+    while (budget-- && Serial.available())
+    {
+      const char c = Serial.read();
+      if ('\r' != c && '\n' != c)
+      {
+        if (len < COMMAND_BUFFER_SIZE - 1)
+        {
+          buffer[len++] = c;
+        }
+        else
+        {
+          overflow = true;
+        }
+        continue;
+      }
+      if (!len && !overflow)
+      {
+        continue;
+      }
+      buffer[len] = '\0';
+      len = 0;
+
+      if (overflow)
+      {
+        overflow = false;
+        Serial.println(F("Error"));
+      }
+      else
+      {
+        execute();
+      }
+      return;
+    }
+  }
+
+  /**
+   * @brief Keep the lowest number of sample sets of the last datalog period, to be called on each datalog event
+   *
+   * @param lowest copyOf_lowestNoOfSampleSetsPerMainsCycle
+   */
+  static void recordSampleSets(uint8_t lowest)
+  {
+    sampleSetsHistory[historyHead] = lowest;
+    historyHead = (historyHead + 1) % SAMPLE_SETS_HISTORY_SIZE;
+  }
+
+  /**
+   * @brief Loads forced with the "force" command
+   *
+   * @return uint8_t bit i for load i
+   */
+  static uint8_t get_forcedLoads()
+  {
+    return forcedLoads;
+  }
+
+private:
+  using Handler = void (*)(char *args);
+  using Lister = bool (*)(uint8_t idx);
+
+  /** A command, stored in flash */
+  struct Command
+  {
+    char name[9];    /**< the name */
+    char help[26];   /**< arguments and short description */
+    Handler handler; /**< executes the command */
+  };
+
+  /** A setting which can be read and changed, stored in flash */
+  struct Setting
+  {
+    char name[17];     /**< the name (member of Settings) */
+    SettingTypes type; /**< the type */
+    uint8_t offset;    /**< offset in Settings */
+  };
+
+  /**
+   * @brief Look up the command in the buffer and execute it
+   *
+   */
+  static void execute()
+  {
+    char *args{ strchr(buffer, ' ') };
+    if (args)
+    {
+      *args++ = '\0';
+    }
+    else
+    {
+      args = buffer + strlen(buffer);
+    }
+
+    for (const auto &command : commands)
+    {
+      if (!strcmp_P(buffer, command.name))
+      {
+        reinterpret_cast< Handler >(pgm_read_ptr(&command.handler))(args);
+        return;
+      }
+    }
+    Serial.println(F("Unknown command, type 'help'"));
+  }
+
+  /**
+   * @brief Start a multi-line answer
+   *
+   */
+  static void startList(Lister newLister)
+  {
+    lister = newLister;
+    listIndex = 0;
+  }
+
+  /**
+   * @brief Print "OK" or "Error"
+   *
+   */
+  static void printResult(bool ok)
+  {
+    Serial.println(ok ? F("OK") : F("Error"));
+  }
+
+  /**
+   * @brief Find a setting by its name
+   *
+   * @return the index of the setting, or UINT8_MAX
+   */
+  static uint8_t findSetting(const char *name)
+  {
+    for (uint8_t i = 0; i < NO_OF_SETTINGS; ++i)
+    {
+      if (!strcmp_P(name, settingsTable[i].name))
+      {
+        return i;
+      }
+    }
+    return UINT8_MAX;
+  }
+
+  /**
+   * @brief Print a setting, e.g. "voltageCal = 0.815100"
+   *
+   */
+  static void printSetting(uint8_t idx)
+  {
+    const auto *setting{ settingsTable + idx };
+    const auto *value{ reinterpret_cast< const uint8_t * >(&settings) + pgm_read_byte(&setting->offset) };
+
+    Serial.print(reinterpret_cast< const __FlashStringHelper * >(setting->name));
+    Serial.print(F(" = "));
+    switch (static_cast< SettingTypes >(pgm_read_byte(&setting->type)))
+    {
+      case SettingTypes::FLOAT:
+        Serial.println(*reinterpret_cast< const float * >(value), 6);
+        break;
+      case SettingTypes::INT16:
+        Serial.println(*reinterpret_cast< const int16_t * >(value));
+        break;
+      case SettingTypes::UINT16:
+        Serial.println(*reinterpret_cast< const uint16_t * >(value));
+        break;
+      case SettingTypes::UINT8:
+        Serial.println(*value);
+        break;
+    }
+  }
+
+  /**
+   * @brief Change a setting, the value is checked against its type
+   *
+   * @return true if the value is valid
+   */
+  static bool writeSetting(uint8_t idx, const char *text)
+  {
+    const auto *setting{ settingsTable + idx };
+    auto *value{ reinterpret_cast< uint8_t * >(&settings) + pgm_read_byte(&setting->offset) };
+    const long number{ atol(text) };
+
+    switch (static_cast< SettingTypes >(pgm_read_byte(&setting->type)))
+    {
+      case SettingTypes::FLOAT:
+      {
+        const float f{ static_cast< float >(atof(text)) };
+        if (f <= 0)
+        {
+          return false;
+        }
+        *reinterpret_cast< float * >(value) = f;
+        break;
+      }
+      case SettingTypes::INT16:
+        if (number < INT16_MIN || number > INT16_MAX)
+        {
+          return false;
+        }
+        *reinterpret_cast< int16_t * >(value) = number;
+        break;
+      case SettingTypes::UINT16:
+        if (number <= 0 || number > UINT16_MAX)
+        {
+          return false;
+        }
+        *reinterpret_cast< uint16_t * >(value) = number;
+        break;
+      case SettingTypes::UINT8:
+        if (number < 0 || number > UINT8_MAX)
+        {
+          return false;
+        }
+        *value = number;
+        break;
+    }
+    return true;
+  }
+
+  /**
+   * @brief "help": list the commands
+   *
+   */
+  static void help(char *)
+  {
+    startList([](uint8_t idx) {
+      Serial.print(reinterpret_cast< const __FlashStringHelper * >(commands[idx].name));
+      Serial.print(' ');
+      Serial.println(reinterpret_cast< const __FlashStringHelper * >(commands[idx].help));
+      return idx + 1 < NO_OF_COMMANDS;
+    });
+  }
+
+  /**
+   * @brief "get [name]": print one or all settings
+   *
+   */
+  static void get(char *args)
+  {
+    if (!*args)
+    {
+      startList([](uint8_t idx) {
+        printSetting(idx);
+        return idx + 1 < NO_OF_SETTINGS;
+      });
+      return;
+    }
+
+    const uint8_t idx{ findSetting(args) };
+    if (idx == UINT8_MAX)
+    {
+      printResult(false);
+      return;
+    }
+    printSetting(idx);
+  }
+
+  /**
+   * @brief "set name value": change a setting, applied at once but not saved
+   *
+   */
+  static void set(char *args)
+  {
+    char *value{ strchr(args, ' ') };
+    if (!value)
+    {
+      printResult(false);
+      return;
+    }
+    *value++ = '\0';
+
+    const uint8_t idx{ findSetting(args) };
+    if (idx == UINT8_MAX || !writeSetting(idx, value))
+    {
+      printResult(false);
+      return;
+    }
+    applySettings();
+    printSetting(idx);
+  }
+
+  /**
+   * @brief "save": save the settings in EEPROM
+   *
+   */
+  static void save(char *)
+  {
+    settingsStore.save();
+    printResult(true);
+  }
+
+  /**
+   * @brief "defaults": restore and save the default settings
+   *
+   */
+  static void defaults(char *)
+  {
+    settingsStore.reset();
+    applySettings();
+    printResult(true);
+  }
+
+  /**
+   * @brief "rotate": rotate the load priorities
+   *
+   */
+  static void rotate(char *)
+  {
+    printResult(controlCommands.push(ControlCommands::ROTATE_LOADS));  // done by the ISR on the next mains cycle
+  }
+
+  /**
+   * @brief "force n on|off": force load n (1-based) or release it
+   *
+   */
+  static void force(char *args)
+  {
+    const uint8_t load = atoi(args) - 1;
+    const char *state{ strchr(args, ' ') };
+
+    if (load >= NO_OF_DUMPLOADS || !state)
+    {
+      printResult(false);
+      return;
+    }
+
+    if (!strcmp_P(state + 1, PSTR("on")))
+    {
+      bit_set(forcedLoads, load);
+    }
+    else if (!strcmp_P(state + 1, PSTR("off")))
+    {
+      bit_clear(forcedLoads, load);
+    }
+    else
+    {
+      printResult(false);
+      return;
+    }
+    printResult(true);
+  }
+
+  /**
+   * @brief "state": print the accumulators and the state of the loads
+   *
+   */
+  static void state(char *)
+  {
+    startList([](uint8_t idx) {
+      switch (idx)
+      {
+        case 0:
+          Serial.print(F("bucket (IEU): "));
+          Serial.println(copyOf_energyInBucket_long);
+          return true;
+        case 1:
+          Serial.print(F("diverted (Wh): "));
+          Serial.println(divertedEnergyTotal_Wh);
+          return true;
+        case 2:
+          Serial.print(F("no diversion (cycles): "));
+          Serial.println(absenceOfDivertedEnergyCount);
+          return true;
+        default:
+          break;
+      }
+
+      // one line per load, in the order of priority
+      const uint8_t prio{ static_cast< uint8_t >(idx - 3) };
+      const uint8_t loadAndState{ loadPrioritiesAndState[prio] };
+      const uint8_t load{ static_cast< uint8_t >(loadAndState & loadStateMask) };
+
+      Serial.print(F("load #"));
+      Serial.print(load + 1);
+      Serial.print(F(": prio "));
+      Serial.print(prio + 1);
+      Serial.print((loadAndState & loadStateOnBit) ? F(", ON") : F(", OFF"));
+      if (b_overrideLoadOn[load])
+      {
+        Serial.print(F(", forced"));
+      }
+      if (!bit_read(allowedLoads, load))
+      {
+        Serial.print(F(", derated"));
+      }
+      Serial.println();
+
+      return prio + 1 < NO_OF_DUMPLOADS;
+    });
+  }
+
+  /**
+   * @brief "energy": print the energy counters of today and since the first start-up
+   *
+   */
+  static void energy(char *)
+  {
+    startList([](uint8_t idx) {
+      const auto &totals{ idx < 3 ? energyCounters.get_today() : energyCounters.get_lifetime() };
+
+      Serial.print(idx < 3 ? F("today ") : F("lifetime "));
+      switch (idx % 3)
+      {
+        case 0:
+          Serial.print(F("diverted (Wh): "));
+          Serial.println(totals.diverted_Wh);
+          break;
+        case 1:
+          Serial.print(F("imported (Wh): "));
+          Serial.println(totals.imported_Wh);
+          break;
+        default:
+          Serial.print(F("exported (Wh): "));
+          Serial.println(totals.exported_Wh);
+          break;
+      }
+
+      return idx < 5;
+    });
+  }
+
+  /**
+   * @brief "history": print the lowest number of sample sets per mains cycle of the last datalog periods, oldest first
+   *
+   */
+  static void history(char *)
+  {
+    startList([](uint8_t idx) {
+      constexpr uint8_t VALUES_PER_LINE{ 8 };
+
+      uint8_t i{ VALUES_PER_LINE };
+      do
+      {
+        Serial.print(sampleSetsHistory[(historyHead + idx * VALUES_PER_LINE + VALUES_PER_LINE - i) % SAMPLE_SETS_HISTORY_SIZE]);
+        Serial.print(' ');
+      } while (--i);
+      Serial.println();
+
+      return (idx + 1) * VALUES_PER_LINE < SAMPLE_SETS_HISTORY_SIZE;
+    });
+  }
+
+  /**
+   * @brief "time [d hh:mm[:ss]]": print or set the time of the mains clock, d from 1 (Monday) to 7 (Sunday)
+   *
+   */
+  static void time(char *args)
+  {
+    if (!*args)
+    {
+      mainsClock.print(Serial);
+      return;
+    }
+
+    const char *hours{ strchr(args, ' ') };
+    const char *minutes{ hours ? strchr(hours, ':') : nullptr };
+    const char *seconds{ minutes ? strchr(minutes + 1, ':') : nullptr };
+
+    const uint8_t day = atoi(args);
+    const uint8_t hh = hours ? atoi(hours) : UINT8_MAX;
+    const uint8_t mm = minutes ? atoi(minutes + 1) : UINT8_MAX;
+    const uint8_t ss = seconds ? atoi(seconds + 1) : 0;
+
+    if (hh < HOURS_PER_DAY && mm < MINUTES_PER_HOUR && ss < SECONDS_PER_MINUTE
+        && mainsClock.set(day - 1, (static_cast< uint32_t >(hh) * MINUTES_PER_HOUR + mm) * SECONDS_PER_MINUTE + ss))
+    {
+      mainsClock.print(Serial);
+      return;
+    }
+    printResult(false);
+  }
+
+#ifdef TEMP_ENABLED
+  /**
+   * @brief "sensors": list the temperature sensors
+   *
+   */
+  static void sensors(char *)
+  {
+    startList([](uint8_t idx) {
+      temperatureSensing.printSensor(idx, Serial);
+      return idx + 1 < temperatureSensing.get_size();
+    });
+  }
+
+  /**
+   * @brief "swap a b": swap the temperature sensors of slots a and b (1-based), the ROM table is saved in EEPROM
+   *
+   */
+  static void swap(char *args)
+  {
+    const char *second{ strchr(args, ' ') };
+    const uint8_t a = atoi(args);
+    const uint8_t b = second ? atoi(second) : 0;
+
+    printResult(temperatureSensing.swapSensors(a - 1, b - 1));
+  }
+#endif
+
+  static constexpr Command commands[] PROGMEM{
+    { "help", "list the commands", &help },
+    { "get", "[name] print settings", &get },
+    { "set", "name value", &set },
+    { "save", "save settings to EEPROM", &save },
+    { "defaults", "restore default settings", &defaults },
+    { "rotate", "rotate load priorities", &rotate },
+    { "force", "n on|off force load n", &force },
+    { "state", "accumulators and loads", &state },
+    { "energy", "today and lifetime energy", &energy },
+    { "history", "lowest sample sets/cycle", &history },
+    { "time", "[d hh:mm[:ss]] d=1..7", &time },
+#ifdef TEMP_ENABLED
+    { "sensors", "list temperature sensors", &sensors },
+    { "swap", "a b swap sensor slots", &swap },
+#endif
+  };
+
+  static constexpr Setting settingsTable[] PROGMEM{
+    { "gridPowerCal", SettingTypes::FLOAT, offsetof(Settings, gridPowerCal) },
+    { "divertedPowerCal", SettingTypes::FLOAT, offsetof(Settings, divertedPowerCal) },
+    { "voltageCal", SettingTypes::FLOAT, offsetof(Settings, voltageCal) },
+    { "requiredExport_W", SettingTypes::INT16, offsetof(Settings, requiredExport_W) },
+    { "workingZone_J", SettingTypes::UINT16, offsetof(Settings, workingZone_J) },
+    { "antiCreepLimit_J", SettingTypes::UINT8, offsetof(Settings, antiCreepLimit_J) },
+  };
+
+  static constexpr uint8_t NO_OF_COMMANDS{ sizeof(commands) / sizeof(Command) };      /**< number of commands */
+  static constexpr uint8_t NO_OF_SETTINGS{ sizeof(settingsTable) / sizeof(Setting) }; /**< number of settings */
+
+  static inline char buffer[COMMAND_BUFFER_SIZE]; /**< the command line being received */
+  static inline uint8_t len{ 0 };                 /**< number of characters in the buffer */
+  static inline bool overflow{ false };           /**< the line is too long */
+
+  static inline Lister lister{ nullptr }; /**< prints the next line of a multi-line answer */
+  static inline uint8_t listIndex{ 0 };   /**< next line of the multi-line answer */
+
+  static inline uint8_t forcedLoads{ 0 }; /**< loads forced with "force", bit i for load i */
+
+  static inline uint8_t sampleSetsHistory[SAMPLE_SETS_HISTORY_SIZE]{}; /**< lowest number of sample sets per mains cycle of each datalog period */
+  static inline uint8_t historyHead{ 0 };                              /**< oldest entry of the history */
+};
+
+inline CommandInterpreter commandInterpreter; /**< Serial command interpreter */
+
+#endif /* UTILS_COMMANDS_H */
@@ -14,6 +14,8 @@
 #define UTILS_DISPLAY_H
 
 #include "config_system.h"
+#include "utils_bcd.h"
+#include "utils_pins.h"
 
 #include "FastDivision.h"
 
@@ -22,11 +24,18 @@
 inline constexpr uint8_t noOfDigitLocations{ 4 };
 inline constexpr uint8_t noOfPossibleCharacters{ 22 };
 inline constexpr uint8_t MAX_DISPLAY_TIME_COUNT{ 10 };            // no of processing loops between display updates
+inline constexpr uint16_t DISPLAY_DIGIT_RATE{ 400 };              // digits per second when multiplexed from Timer2 (100 Hz per frame)
 inline constexpr uint8_t UPDATE_PERIOD_FOR_DISPLAYED_DATA{ 50 };  // mains cycles
 inline constexpr uint8_t DISPLAY_SHUTDOWN_IN_HOURS{ 8 };          // auto-reset after this period of inactivity
 
 inline constexpr uint32_t displayShutdown_inMainsCycles{ DISPLAY_SHUTDOWN_IN_HOURS * mainsCyclesPerHour };
 
+// Timer2 in CTC mode, clocked at F_CPU / 256
+inline constexpr uint16_t DISPLAY_TIMER_TOP{ F_CPU / 256UL / DISPLAY_DIGIT_RATE - 1 };
+
+static_assert(DISPLAY_TIMER_TOP <= UINT8_MAX, "******** DISPLAY_DIGIT_RATE is too low for Timer2 ! ********");
+static_assert(!DISPLAY_TIMER_DRIVEN | (TYPE_OF_DISPLAY == DisplayType::SEG) | (TYPE_OF_DISPLAY == DisplayType::SEG_HW), "******** DISPLAY_TIMER_DRIVEN needs a 7-segments display ! ********");
+
 ////////////////////////////////////////////////////////////////////////////////////////
 // The 7-segment display can be driven in two ways:
 // 1. By a set of logic chips (74HC4543 7-segment display driver and 74HC138 2->4 line demultiplexer)
@@ -51,45 +60,54 @@ inline constexpr uint8_t digitLocationLine[noOfDigitLocationLines]{ 16, 15 };
 inline constexpr uint8_t digitSelectionLine[noOfDigitSelectionLines]{ 7, 9, 8, 6 };
 
 ////////////////////////////////////////////////////////////////////////////////////////
-// The final column of digitValueMap[] is for the decimal point status.  In this version,
-// the decimal point has to be treated differently than the other seven segments, so
-// a convenient means of accessing this column is provided.
+// Each character is stored as one byte: bits 0..3 are the states of digitSelectionLine[0..3],
+// bit 4 is the decimal point. In this version, the decimal point has to be treated differently
+// than the other seven segments since the driver chip doesn't mask it.
 //
-inline constexpr uint8_t digitValueMap[noOfPossibleCharacters][noOfDigitSelectionLines + 1]{
-  LOW, LOW, LOW, LOW, LOW,      // '0' <- element 0
-  LOW, LOW, LOW, HIGH, LOW,     // '1' <- element 1
-  LOW, LOW, HIGH, LOW, LOW,     // '2' <- element 2
-  LOW, LOW, HIGH, HIGH, LOW,    // '3' <- element 3
-  LOW, HIGH, LOW, LOW, LOW,     // '4' <- element 4
-  LOW, HIGH, LOW, HIGH, LOW,    // '5' <- element 5
-  LOW, HIGH, HIGH, LOW, LOW,    // '6' <- element 6
-  LOW, HIGH, HIGH, HIGH, LOW,   // '7' <- element 7
-  HIGH, LOW, LOW, LOW, LOW,     // '8' <- element 8
-  HIGH, LOW, LOW, HIGH, LOW,    // '9' <- element 9
-  LOW, LOW, LOW, LOW, HIGH,     // '0.' <- element 10
-  LOW, LOW, LOW, HIGH, HIGH,    // '1.' <- element 11
-  LOW, LOW, HIGH, LOW, HIGH,    // '2.' <- element 12
-  LOW, LOW, HIGH, HIGH, HIGH,   // '3.' <- element 13
-  LOW, HIGH, LOW, LOW, HIGH,    // '4.' <- element 14
-  LOW, HIGH, LOW, HIGH, HIGH,   // '5.' <- element 15
-  LOW, HIGH, HIGH, LOW, HIGH,   // '6.' <- element 16
-  LOW, HIGH, HIGH, HIGH, HIGH,  // '7.' <- element 17
-  HIGH, LOW, LOW, LOW, HIGH,    // '8.' <- element 18
-  HIGH, LOW, LOW, HIGH, HIGH,   // '9.' <- element 19
-  HIGH, HIGH, HIGH, HIGH, LOW,  // ' '  <- element 20
-  HIGH, HIGH, HIGH, HIGH, HIGH  // '.'  <- element 21
+inline constexpr uint8_t digitValueGlyph[noOfPossibleCharacters]{
+  0b00000,  // '0' <- element 0
+  0b01000,  // '1' <- element 1
+  0b00100,  // '2' <- element 2
+  0b01100,  // '3' <- element 3
+  0b00010,  // '4' <- element 4
+  0b01010,  // '5' <- element 5
+  0b00110,  // '6' <- element 6
+  0b01110,  // '7' <- element 7
+  0b00001,  // '8' <- element 8
+  0b01001,  // '9' <- element 9
+  0b10000,  // '0.' <- element 10
+  0b11000,  // '1.' <- element 11
+  0b10100,  // '2.' <- element 12
+  0b11100,  // '3.' <- element 13
+  0b10010,  // '4.' <- element 14
+  0b11010,  // '5.' <- element 15
+  0b10110,  // '6.' <- element 16
+  0b11110,  // '7.' <- element 17
+  0b10001,  // '8.' <- element 18
+  0b11001,  // '9.' <- element 19
+  0b01111,  // ' '  <- element 20
+  0b11111   // '.'  <- element 21
 };
 
-// a tidy means of identifying the DP status data when accessing the above table
-inline constexpr uint8_t DPstatus_columnID = noOfDigitSelectionLines;
-
-inline constexpr uint8_t digitLocationMap[noOfDigitLocations][noOfDigitLocationLines]{
-  LOW, LOW,    // Digit 1
-  LOW, HIGH,   // Digit 2
-  HIGH, LOW,   // Digit 3
-  HIGH, HIGH,  // Digit 4
+// the lines driven by digitValueGlyph[], in the bit order of the glyphs
+inline constexpr uint8_t digitValuePin[noOfDigitSelectionLines + 1]{ digitSelectionLine[0], digitSelectionLine[1],
+                                                                     digitSelectionLine[2], digitSelectionLine[3],
+                                                                     decimalPointLine };
+
+// bit i is the state of digitLocationLine[i]
+inline constexpr uint8_t digitLocationGlyph[noOfDigitLocations]{
+  0b00,  // Digit 1
+  0b10,  // Digit 2
+  0b01,  // Digit 3
+  0b11,  // Digit 4
 };
 
+inline constexpr PortValues digitValueMasks{ portMasks(digitValuePin) };
+inline constexpr PortValues digitLocationMasks{ portMasks(digitLocationLine) };
+
+inline constexpr PortValuesTable< noOfPossibleCharacters > digitValuePorts PROGMEM{ makePortValuesTable(digitValueGlyph, digitValuePin) };
+inline constexpr PortValuesTable< noOfDigitLocations > digitLocationPorts PROGMEM{ makePortValuesTable(digitLocationGlyph, digitLocationLine) };
+
 // End of config for the version with the extra logic chips
 ////////////////////////////////////////////////////////////////////////////////////////
 
@@ -108,40 +126,102 @@ inline constexpr uint8_t digitSelectorPin[noOfDigitLocations]{ 16, 10, 13, 11 };
 inline constexpr uint8_t segmentDrivePin[noOfSegmentsPerDigit]{ 2, 5, 12, 6, 7, 9, 8, 14 };
 
 ////////////////////////////////////////////////////////////////////////////////////////
-// The final column of segMap[] is for the decimal point status.  In this version,
-// the decimal point is treated just like all the other segments, so there is
-// no need to access this column specifically.
+// Each character is stored as one byte: bit i is the state of segmentDrivePin[i].
+// The decimal point is treated just like all the other segments (bit 7).
 //
-inline constexpr uint8_t segMap[noOfPossibleCharacters][noOfSegmentsPerDigit]{
-  ON, ON, ON, ON, ON, ON, OFF, OFF,        // '0' <- element 0
-  OFF, ON, ON, OFF, OFF, OFF, OFF, OFF,    // '1' <- element 1
-  ON, ON, OFF, ON, ON, OFF, ON, OFF,       // '2' <- element 2
-  ON, ON, ON, ON, OFF, OFF, ON, OFF,       // '3' <- element 3
-  OFF, ON, ON, OFF, OFF, ON, ON, OFF,      // '4' <- element 4
-  ON, OFF, ON, ON, OFF, ON, ON, OFF,       // '5' <- element 5
-  ON, OFF, ON, ON, ON, ON, ON, OFF,        // '6' <- element 6
-  ON, ON, ON, OFF, OFF, OFF, OFF, OFF,     // '7' <- element 7
-  ON, ON, ON, ON, ON, ON, ON, OFF,         // '8' <- element 8
-  ON, ON, ON, ON, OFF, ON, ON, OFF,        // '9' <- element 9
-  ON, ON, ON, ON, ON, ON, OFF, ON,         // '0.' <- element 10
-  OFF, ON, ON, OFF, OFF, OFF, OFF, ON,     // '1.' <- element 11
-  ON, ON, OFF, ON, ON, OFF, ON, ON,        // '2.' <- element 12
-  ON, ON, ON, ON, OFF, OFF, ON, ON,        // '3.' <- element 13
-  OFF, ON, ON, OFF, OFF, ON, ON, ON,       // '4.' <- element 14
-  ON, OFF, ON, ON, OFF, ON, ON, ON,        // '5.' <- element 15
-  ON, OFF, ON, ON, ON, ON, ON, ON,         // '6.' <- element 16
-  ON, ON, ON, OFF, OFF, OFF, OFF, ON,      // '7.' <- element 17
-  ON, ON, ON, ON, ON, ON, ON, ON,          // '8.' <- element 18
-  ON, ON, ON, ON, OFF, ON, ON, ON,         // '9.' <- element 19
-  OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF,  // ' ' <- element 20
-  OFF, OFF, OFF, OFF, OFF, OFF, OFF, ON    // '.' <- element 11
+inline constexpr uint8_t segGlyph[noOfPossibleCharacters]{
+  0b00111111,  // '0' <- element 0
+  0b00000110,  // '1' <- element 1
+  0b01011011,  // '2' <- element 2
+  0b01001111,  // '3' <- element 3
+  0b01100110,  // '4' <- element 4
+  0b01101101,  // '5' <- element 5
+  0b01111101,  // '6' <- element 6
+  0b00000111,  // '7' <- element 7
+  0b01111111,  // '8' <- element 8
+  0b01101111,  // '9' <- element 9
+  0b10111111,  // '0.' <- element 10
+  0b10000110,  // '1.' <- element 11
+  0b11011011,  // '2.' <- element 12
+  0b11001111,  // '3.' <- element 13
+  0b11100110,  // '4.' <- element 14
+  0b11101101,  // '5.' <- element 15
+  0b11111101,  // '6.' <- element 16
+  0b10000111,  // '7.' <- element 17
+  0b11111111,  // '8.' <- element 18
+  0b11101111,  // '9.' <- element 19
+  0b00000000,  // ' ' <- element 20
+  0b10000000   // '.' <- element 21
 };
 
+static_assert(ON == HIGH, "segGlyph[] is written for active-high segments");
+
+inline constexpr PortValues segmentMasks{ portMasks(segmentDrivePin) };
+inline constexpr PortValues digitSelectorMasks{ portMasks(digitSelectorPin) };
+inline constexpr PortValues allDigitsDisabled{ DIGIT_DISABLED ? digitSelectorMasks : PortValues{} };
+
+// the glyphs, spread over the I/O ports: a character is displayed with at most 3 port writes
+inline constexpr PortValuesTable< noOfPossibleCharacters > segPorts PROGMEM{ makePortValuesTable(segGlyph, segmentDrivePin) };
+
+// bit i is the state of digitSelectorPin[i]: only the active location is enabled
+inline constexpr uint8_t digitSelectorGlyph[noOfDigitLocations]{ 0b1110, 0b1101, 0b1011, 0b0111 };
+
+static_assert(DIGIT_ENABLED == LOW, "digitSelectorGlyph[] is written for active-low digit selectors");
+
+inline constexpr PortValuesTable< noOfDigitLocations > digitSelectorPorts PROGMEM{ makePortValuesTable(digitSelectorGlyph, digitSelectorPin) };
+
 // End of config for the version without the extra logic chips
 ////////////////////////////////////////////////////////////////////////////////////////
 
 uint8_t charsForDisplay[noOfDigitLocations]{ 20, 20, 20, 20 };  // all blank
 
+// the characters of charsForDisplay[], already spread over the I/O ports (segments or driver lines)
+// read by the Timer2 interrupt when DISPLAY_TIMER_DRIVEN is set
+volatile PortValues frameBuffer[noOfDigitLocations];
+
+inline void displayNextDigit() __attribute__((always_inline));
+
+/**
+ * @brief Rebuild the frame buffer from charsForDisplay[]
+ * @details Called each time the displayed value changes, so that the multiplexing
+ *          only has to copy ready-made port values.
+ *          Each digit is written with interrupts disabled, so the Timer2 interrupt
+ *          never sees the 3 port bytes of a digit half-updated.
+ *
+ * @ingroup 7SegDisplay
+ */
+void updateFrameBuffer()
+{
+  uint8_t i{ noOfDigitLocations };
+  do
+  {
+    --i;
+    const auto values{ TYPE_OF_DISPLAY == DisplayType::SEG_HW ? readPortValues_P(&digitValuePorts.values[charsForDisplay[i]])
+                                                               : readPortValues_P(&segPorts.values[charsForDisplay[i]]) };
+
+    const uint8_t oldSREG{ SREG };
+    cli();
+    frameBuffer[i].d = values.d;
+    frameBuffer[i].b = values.b;
+    frameBuffer[i].c = values.c;
+    SREG = oldSREG;
+  } while (i);
+}
+
+/**
+ * @brief Read the port values of a digit from the frame buffer
+ * @details Called from displayNextDigit(), the frame buffer can't change meanwhile.
+ *
+ * @param idx The digit location
+ * @return PortValues The port values of the digit
+ *
+ * @ingroup 7SegDisplay
+ */
+inline PortValues readFrameBuffer(uint8_t idx)
+{
+  return { frameBuffer[idx].d, frameBuffer[idx].b, frameBuffer[idx].c };
+}
+
 /**
  * @brief Initializes the display based on the type of display defined by TYPE_OF_DISPLAY.
  * 
@@ -160,6 +240,9 @@ uint8_t charsForDisplay[noOfDigitLocations]{ 20, 20, 20, 20 };  // all blank
  *   - Sets the pin mode for each digit selector pin.
  *   - Disables all digit selector pins initially.
  *   - Turns off all segment drive pins initially.
+ *
+ * When DISPLAY_TIMER_DRIVEN is set, Timer2 is also configured to fire the multiplexing
+ * interrupt DISPLAY_DIGIT_RATE times per second.
  * 
  * @ingroup 7SegDisplay
  */
@@ -210,6 +293,18 @@ void initializeDisplay()
       setPinState(segmentDrivePin[i], OFF);
     }
   }
+
+  updateFrameBuffer();
+
+  if constexpr (DISPLAY_TIMER_DRIVEN)
+  {
+    // Timer2 is taken over from the Arduino core (PWM on pins 3 and 11 is no longer available)
+    TCCR2A = bit(WGM21);              // CTC mode, no output
+    TCCR2B = bit(CS22) | bit(CS21);  // prescaler 256
+    OCR2A = DISPLAY_TIMER_TOP;
+    TCNT2 = 0;
+    TIMSK2 = bit(OCIE2A);  // enable the compare match interrupt
+  }
 }
 
 /**
@@ -226,6 +321,7 @@ void initializeDisplay()
  * and assigns digits to the display characters. If the value exceeds 10,000, it
  * is rescaled to fit within the display's constraints. The decimal point is placed
  * after the first or second digit based on the value.
+ * The digits are converted with bin2bcd(), and only when the value has changed.
  *
  * When the energy display is not active, the function displays a "walking dots"
  * pattern by cycling a dot through the display positions.
@@ -237,37 +333,29 @@ void configureValueForDisplay(const bool _EDD_isActive, const uint16_t _ValueToD
   if constexpr (TYPE_OF_DISPLAY == DisplayType::SEG || TYPE_OF_DISPLAY == DisplayType::SEG_HW)
   {
     static uint8_t locationOfDot = 0;
+    static uint16_t displayedValue{ 0 };
+    static bool displayedValueIsValid{ false };
 
     if (_EDD_isActive)
     {
-      uint16_t val = _ValueToDisplay;
-      bool energyValueExceeds10kWh;
-
-      if (val < 10000)
+      // the digits only need to be recomputed when the value has changed
+      if (displayedValueIsValid && _ValueToDisplay == displayedValue)
       {
-        // no need to re-scale (display to 3 DPs)
-        energyValueExceeds10kWh = false;
-      }
-      else
-      {
-        // re-scale is needed (display to 2 DPs)
-        energyValueExceeds10kWh = true;
-        val = divu10(val);
+        return;
       }
+      displayedValue = _ValueToDisplay;
+      displayedValueIsValid = true;
 
-      uint8_t thisDigit = divu10(divu10(divu10(val)));
-      charsForDisplay[0] = thisDigit;
-      val -= 1000 * thisDigit;
+      const uint32_t bcd{ bin2bcd(_ValueToDisplay) };
 
-      thisDigit = divu10(divu10(val));
-      charsForDisplay[1] = thisDigit;
-      val -= 100 * thisDigit;
+      // display to 3 DPs, or to 2 DPs when the value exceeds 10 kWh (the last digit is dropped)
+      const bool energyValueExceeds10kWh{ _ValueToDisplay >= 10000 };
+      const uint8_t lowestDigit{ static_cast< uint8_t >(energyValueExceeds10kWh ? 1 : 0) };
 
-      thisDigit = divu10(val);
-      charsForDisplay[2] = thisDigit;
-      val -= 10 * thisDigit;
-
-      charsForDisplay[3] = val;
+      charsForDisplay[0] = bcdDigit(bcd, lowestDigit + 3);
+      charsForDisplay[1] = bcdDigit(bcd, lowestDigit + 2);
+      charsForDisplay[2] = bcdDigit(bcd, lowestDigit + 1);
+      charsForDisplay[3] = bcdDigit(bcd, lowestDigit);
 
       // assign the decimal point location
       if (energyValueExceeds10kWh)
@@ -281,6 +369,8 @@ void configureValueForDisplay(const bool _EDD_isActive, const uint16_t _ValueToD
     }
     else
     {
+      displayedValueIsValid = false;
+
       // "walking dots" display
       charsForDisplay[locationOfDot] = 20;  // blank
 
@@ -292,15 +382,15 @@ void configureValueForDisplay(const bool _EDD_isActive, const uint16_t _ValueToD
 
       charsForDisplay[locationOfDot] = 21;  // dot
     }
+
+    updateFrameBuffer();
   }
 }
 
 /**
- * @brief Refreshes the display by updating the active digit and its segments.
+ * @brief Displays the next digit location.
  *
- * This routine manages the display of digits on a 7-segment display. It keeps track of 
- * which digit is currently being displayed and updates the display when the current 
- * digit's display time has expired. The logic differs based on the type of display hardware.
+ * The logic differs based on the type of display hardware.
  *
  * For DisplayType::SEG_HW:
  * 1. Sets the decimal point line to 'off'.
@@ -309,7 +399,7 @@ void configureValueForDisplay(const bool _EDD_isActive, const uint16_t _ValueToD
  * 4. Sets up the location lines for the new active location.
  * 5. Determines the relevant character for the new active location.
  * 6. Configures the driver chip for the new character to be displayed.
- * 7. Sets up the decimal point line for the new active location.
+ * 7. Sets up the decimal point line for the new active location (together with step 6).
  * 8. Enables the 7-segment driver chip.
  *
  * For DisplayType::SEG:
@@ -319,18 +409,15 @@ void configureValueForDisplay(const bool _EDD_isActive, const uint16_t _ValueToD
  * 4. Sets up the segment drivers for the character to be displayed (includes the DP).
  * 5. Activates the digit-enable line for the new active location.
  *
- * The function uses static variables to keep track of the display time count and the 
- * currently active digit location. When the display time count exceeds a predefined 
- * maximum value, the function updates the display to show the next digit.
- * 
+ * The characters are taken from the frame buffer, already spread over the I/O ports,
+ * so a character is displayed with at most 3 masked port writes.
+ * It's short enough (a few dozen cycles) to be run from the Timer2 interrupt.
+ *
  * @ingroup 7SegDisplay
  */
-void refreshDisplay()
+void displayNextDigit()
 {
-  // This routine keeps track of which digit is being displayed and checks when its
-  // display time has expired.  It then makes the necessary adjustments for displaying
-  // the next digit.
-  //   The two versions of the hardware require different logic.
+  static uint8_t digitLocationThatIsActive{ 0 };
 
   if constexpr (TYPE_OF_DISPLAY == DisplayType::SEG_HW)
   {
@@ -348,52 +435,30 @@ void refreshDisplay()
     // 7. set up decimal point line for the new active location
     // 8. enable the 7-segment driver chip
 
-    static uint8_t displayTime_count = 0;
-    static uint8_t digitLocationThatIsActive = 0;
+    // 1. disable the Decimal Point driver line;
+    setPinState(decimalPointLine, LOW);
 
-    ++displayTime_count;
+    // 2. disable the driver chip while changes are taking place
+    setPinState(enableDisableLine, DRIVER_CHIP_DISABLED);
 
-    if (displayTime_count > MAX_DISPLAY_TIME_COUNT)
+    // 3. determine the next digit location to be active
+    ++digitLocationThatIsActive;
+    if (digitLocationThatIsActive >= noOfDigitLocations)
     {
-      displayTime_count = 0;
-
-      // 1. disable the Decimal Point driver line;
-      setPinState(decimalPointLine, LOW);
-
-      // 2. disable the driver chip while changes are taking place
-      setPinState(enableDisableLine, DRIVER_CHIP_DISABLED);
-
-      // 3. determine the next digit location to be active
-      ++digitLocationThatIsActive;
-      if (digitLocationThatIsActive >= noOfDigitLocations)
-      {
-        digitLocationThatIsActive = 0;
-      }
-
-      // 4. set up the digit location drivers for the new active location
-      for (uint8_t line = 0; line < noOfDigitLocationLines; ++line)
-      {
-        const auto lineState{ digitLocationMap[digitLocationThatIsActive][line] };
-        setPinState(digitLocationLine[line], lineState);
-      }
-
-      // 5. determine the character to be displayed at this new location
-      // (which includes the decimal point information)
-      const auto digitVal{ charsForDisplay[digitLocationThatIsActive] };
+      digitLocationThatIsActive = 0;
+    }
 
-      // 6. configure the 7-segment driver for the character to be displayed
-      for (uint8_t line = 0; line < noOfDigitSelectionLines; ++line)
-      {
-        const auto lineState{ digitValueMap[digitVal][line] };
-        setPinState(digitSelectionLine[line], lineState);
-      }
+    // 4. set up the digit location drivers for the new active location
+    writePorts(digitLocationMasks, readPortValues_P(&digitLocationPorts.values[digitLocationThatIsActive]));
 
-      // 7. set up the Decimal Point driver line;
-      setPinState(decimalPointLine, digitValueMap[digitVal][DPstatus_columnID]);
+    // 5. determine the character to be displayed at this new location
+    // (which includes the decimal point information)
+    // 6. configure the 7-segment driver for the character to be displayed
+    // 7. set up the Decimal Point driver line (written together with the driver lines)
+    writePorts(digitValueMasks, readFrameBuffer(digitLocationThatIsActive));
 
-      // 8. enable the 7-segment driver chip
-      setPinState(enableDisableLine, DRIVER_CHIP_ENABLED);
-    }
+    // 8. enable the 7-segment driver chip
+    setPinState(enableDisableLine, DRIVER_CHIP_ENABLED);
   }
   else if (TYPE_OF_DISPLAY == DisplayType::SEG)
   {
@@ -407,39 +472,68 @@ void refreshDisplay()
     // 4. set up the segment drivers for the character to be displayed (includes the DP)
     // 5. activate the digit-enable line for the new active location
 
-    static uint8_t displayTime_count{ 0 };
-    static uint8_t digitLocationThatIsActive{ 0 };
-
-    ++displayTime_count;
+    // 1. de-activate the location which is currently being displayed
+    writePorts(digitSelectorMasks, allDigitsDisabled);
 
-    if (displayTime_count > MAX_DISPLAY_TIME_COUNT)
+    // 2. determine the next digit location which is to be displayed
+    ++digitLocationThatIsActive;
+    if (digitLocationThatIsActive >= noOfDigitLocations)
     {
-      displayTime_count = 0;
+      digitLocationThatIsActive = 0;
+    }
 
-      // 1. de-activate the location which is currently being displayed
-      setPinState(digitSelectorPin[digitLocationThatIsActive], DIGIT_DISABLED);
+    // 3. determine the relevant character for the new active location
+    // 4. set up the segment drivers for the character to be displayed (includes the DP)
+    writePorts(segmentMasks, readFrameBuffer(digitLocationThatIsActive));
 
-      // 2. determine the next digit location which is to be displayed
-      ++digitLocationThatIsActive;
-      if (digitLocationThatIsActive >= noOfDigitLocations)
-      {
-        digitLocationThatIsActive = 0;
-      }
+    // 5. activate the digit-enable line for the new active location
+    writePorts(digitSelectorMasks, readPortValues_P(&digitSelectorPorts.values[digitLocationThatIsActive]));
+  }
+}
 
-      // 3. determine the relevant character for the new active location
-      const auto digitVal{ charsForDisplay[digitLocationThatIsActive] };
+/**
+ * @brief Refreshes the display from loop().
+ *
+ * This routine keeps track of which digit is being displayed and checks when its
+ * display time has expired. It then displays the next digit.
+ *
+ * When DISPLAY_TIMER_DRIVEN is set, the multiplexing is done by the Timer2 interrupt
+ * and this function does nothing.
+ * 
+ * @ingroup 7SegDisplay
+ */
+void refreshDisplay()
+{
+  if constexpr (DISPLAY_TIMER_DRIVEN || (TYPE_OF_DISPLAY != DisplayType::SEG && TYPE_OF_DISPLAY != DisplayType::SEG_HW))
+  {
+    return;
+  }
 
-      // 4. set up the segment drivers for the character to be displayed (includes the DP)
-      for (uint8_t segment = 0; segment < noOfSegmentsPerDigit; ++segment)
-      {
-        uint8_t segmentState = segMap[digitVal][segment];
-        setPinState(segmentDrivePin[segment], segmentState);
-      }
+  static uint8_t displayTime_count{ 0 };
 
-      // 5. activate the digit-enable line for the new active location
-      setPinState(digitSelectorPin[digitLocationThatIsActive], DIGIT_ENABLED);
-    }
+  ++displayTime_count;
+
+  if (displayTime_count > MAX_DISPLAY_TIME_COUNT)
+  {
+    displayTime_count = 0;
+
+    displayNextDigit();
   }
 }  // end of refreshDisplay()
 
+#ifdef DISPLAY_TIMER_ENABLED
+/**
+ * @brief Interrupt Service Routine - Timer2 compare match, display multiplexing
+ * @details Only built with DISPLAY_TIMER_ENABLED, otherwise Timer2 stays free (tone(), PWM...).
+ *          Interrupts are re-enabled on entry (ISR_NOBLOCK), so the ADC interrupt
+ *          is never delayed by the display.
+ *
+ * @ingroup 7SegDisplay
+ */
+ISR(TIMER2_COMPA_vect, ISR_NOBLOCK)
+{
+  displayNextDigit();
+}
+#endif
+
 #endif /* UTILS_DISPLAY_H */
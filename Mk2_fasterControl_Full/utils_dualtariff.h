@@ -51,4 +51,15 @@ private:
   uint16_t uiDuration{ UINT16_MAX }; /**< the duration for overriding the load in hours or minutes */
 };
 
+/** @brief Daily energy target of a load, for the energy-target boost
+ *  @details During the off-peak period, the load is forced only for the energy it's still missing
+ *           to reach its daily target, as late as possible before the end of the period.
+ *           The rated power of the load gives the time needed for the missing energy.
+ */
+struct LoadEnergyTarget
+{
+  uint16_t target_Wh{ 0 };    /**< daily energy target in Wh, 0 to disable */
+  uint16_t ratedPower_W{ 0 }; /**< rated power of the load in W */
+};
+
 #endif  // UTILS_DUALTARIFF_H
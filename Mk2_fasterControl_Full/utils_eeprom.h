@@ -0,0 +1,136 @@
+/**
+ * @file utils_eeprom.h
+ * @author Frédéric Metrich (frederic.metrich@live.fr)
+ * @brief Wear-levelled storage of a record in EEPROM
+ * @version 0.1
+ * @date 2024-12-09
+ *
+ * @copyright Copyright (c) 2024
+ *
+ * @section description Description
+ * Each save goes into the next of SLOTS slots, with a sequence number, a version and a CRC.
+ * The valid slot with the latest sequence number is loaded.
+ * This spreads the wear over all the slots, and a save interrupted by a power cut only
+ * loses the new values.
+ *
+ * EEPROM.put() only writes the bytes which have changed.
+ */
+
+#ifndef UTILS_EEPROM_H
+#define UTILS_EEPROM_H
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <util/crc16.h>
+
+/**
+ * @brief Wear-levelled slots in EEPROM holding a record of type T
+ * @details All members are static: each instantiation owns its EEPROM area.
+ *
+ * @tparam T Type of the record
+ * @tparam ADDRESS EEPROM address of the first slot
+ * @tparam SLOTS Number of slots the saves rotate over
+ * @tparam VERSION Layout version of T, slots of another version are ignored
+ */
+template< typename T, uint16_t ADDRESS, uint8_t SLOTS, uint8_t VERSION >
+class EepromSlots
+{
+public:
+  /**
+   * @brief A slot, as saved in EEPROM
+   *
+   */
+  struct Slot
+  {
+    uint8_t version;  /**< VERSION */
+    uint8_t sequence; /**< incremented on each save */
+    T data;           /**< the record */
+    uint8_t crc;      /**< CRC-8 of the above */
+  };
+
+  static constexpr uint16_t END{ ADDRESS + SLOTS * sizeof(Slot) }; /**< first EEPROM address after the slots */
+
+  /**
+   * @brief Load the latest valid slot
+   *
+   * @param data Receives the record, left unchanged if no valid slot is found
+   * @return true if a valid slot has been found
+   */
+  static bool load(T &data)
+  {
+    bool found{ false };
+    Slot slot;
+
+    uint8_t i{ SLOTS };
+    do
+    {
+      --i;
+      EEPROM.get(slotAddress(i), slot);
+
+      if (VERSION != slot.version || crc8(slot) != slot.crc)
+      {
+        continue;
+      }
+      if (!found || static_cast< int8_t >(slot.sequence - sequence) > 0)
+      {
+        found = true;
+        currentSlot = i;
+        sequence = slot.sequence;
+        data = slot.data;
+      }
+    } while (i);
+
+    return found;
+  }
+
+  /**
+   * @brief Save the record into the next slot
+   *
+   * @param data The record
+   */
+  static void save(const T &data)
+  {
+    Slot slot{};
+
+    currentSlot = (currentSlot + 1) % SLOTS;
+    ++sequence;
+
+    slot.version = VERSION;
+    slot.sequence = sequence;
+    slot.data = data;
+    slot.crc = crc8(slot);
+
+    EEPROM.put(slotAddress(currentSlot), slot);
+  }
+
+private:
+  /**
+   * @brief EEPROM address of a slot
+   *
+   */
+  static constexpr uint16_t slotAddress(uint8_t idx)
+  {
+    return ADDRESS + idx * sizeof(Slot);
+  }
+
+  /**
+   * @brief CRC of a slot, without the CRC byte
+   *
+   */
+  static uint8_t crc8(const Slot &slot)
+  {
+    const auto *data{ reinterpret_cast< const uint8_t * >(&slot) };
+    uint8_t crc{ 0 };
+
+    for (uint8_t i = 0; i < offsetof(Slot, crc); ++i)
+    {
+      crc = _crc8_ccitt_update(crc, data[i]);
+    }
+    return crc;
+  }
+
+  static inline uint8_t currentSlot{ SLOTS - 1 }; /**< slot of the record in use, the first save goes into slot 0 */
+  static inline uint8_t sequence{ 0 };            /**< sequence number of the record in use */
+};
+
+#endif /* UTILS_EEPROM_H */
@@ -0,0 +1,226 @@
+/**
+ * @file utils_energy.h
+ * @author Frédéric Metrich (frederic.metrich@live.fr)
+ * @brief Lifetime and daily energy counters, kept in EEPROM
+ * @version 0.1
+ * @date 2024-12-09
+ *
+ * @copyright Copyright (c) 2024
+ *
+ * @section description Description
+ * The diverted, imported and exported energies are counted in Wh on 32 bits, for the current day
+ * and since the first start-up. They are fed on each datalog event from the Wh registers of the ISR.
+ * The counters are restored at start-up, so a power cut only loses the energy counted since the last save.
+ *
+ * To spare the EEPROM, the counters are only saved:
+ * - at midnight (see MainsClock), after clearing the daily counters,
+ * - once ENERGY_SAVE_DELTA_Wh have been counted since the last save,
+ * - when the mains disappears (no mains cycle for MAINS_LOSS_TIMEOUT_MS), as a last save while the
+ *   capacitors of the power supply still hold the board up. The Wh registers of the ISR are read first,
+ *   so the energy counted since the last datalog event is saved too.
+ *
+ * The power supply must hold the board up for about 150 ms after the mains has gone: 60 ms to detect
+ * the loss, then up to 27 bytes (one slot) written in EEPROM at 3.4 ms each, so about 92 ms.
+ *
+ * The saves rotate over ENERGY_SLOTS wear-levelled slots (see utils_eeprom.h). With 30 kWh counted a day,
+ * that's about 60 saves a day, so less than 8 writes per slot and per day: the 100,000 cycles of the EEPROM
+ * last over 30 years.
+ */
+
+#ifndef UTILS_ENERGY_H
+#define UTILS_ENERGY_H
+
+#include <Arduino.h>
+
+#include "config_system.h"
+#include "processing.h"
+#include "utils_eeprom.h"
+#include "utils_rtc.h"
+#include "utils_settings.h"
+
+inline constexpr uint16_t ENERGY_EEPROM_ADDRESS{ SETTINGS_EEPROM_END }; /**< location of the energy slots in EEPROM (after the settings) */
+inline constexpr uint8_t ENERGY_VERSION{ 1 };                           /**< layout version of the energy counters */
+inline constexpr uint8_t ENERGY_SLOTS{ 8 };                             /**< number of slots the saves rotate over */
+inline constexpr uint16_t ENERGY_SAVE_DELTA_Wh{ 500 };                  /**< energy counted (all counters together) which triggers a save */
+inline constexpr uint8_t MAINS_LOSS_TIMEOUT_MS{ 60 };                   /**< without mains cycle during this delay, the mains is considered lost */
+
+/**
+ * @brief Diverted, imported and exported energies
+ *
+ */
+struct EnergyTotals
+{
+  uint32_t diverted_Wh{ 0 }; /**< diverted energy */
+  uint32_t imported_Wh{ 0 }; /**< energy imported from the grid */
+  uint32_t exported_Wh{ 0 }; /**< energy exported to the grid */
+};
+
+/**
+ * @brief Energy counters, as saved in EEPROM
+ *
+ */
+struct EnergyRecord
+{
+  EnergyTotals lifetime; /**< since the first start-up */
+  EnergyTotals today;    /**< since midnight */
+};
+
+using EnergySlots = EepromSlots< EnergyRecord, ENERGY_EEPROM_ADDRESS, ENERGY_SLOTS, ENERGY_VERSION >; /**< EEPROM slots of the energy counters */
+
+inline constexpr uint16_t ENERGY_EEPROM_END{ EnergySlots::END }; /**< first EEPROM address after the slots */
+
+/**
+ * @brief Persistent energy counters
+ * @details All members are static: there's only one set of counters.
+ *
+ */
+class EnergyCounters
+{
+public:
+  /**
+   * @brief Restore the counters from EEPROM, to be called once in setup()
+   *
+   */
+  static void begin()
+  {
+    EnergySlots::load(record);
+
+    lastDiverted_Wh = divertedEnergyTotal_Wh;
+    lastImported_Wh = importedEnergyTotal_Wh;
+    lastExported_Wh = exportedEnergyTotal_Wh;
+    lastDay = mainsClock.get_dayCount();
+    lastCycleCount = getMainsCycleCount();
+    lastCycle_ms = millis();
+  }
+
+  /**
+   * @brief Count the energies of the last datalog period, to be called on each datalog event
+   * @details The Wh registers of the ISR are only 16-bit wide, they are read often enough not to wrap twice.
+   *
+   */
+  static void addDatalogPeriod()
+  {
+    readRegisters();
+
+    if (unsaved_Wh >= ENERGY_SAVE_DELTA_Wh)
+    {
+      save();
+    }
+  }
+
+  /**
+   * @brief Handle midnight and the loss of the mains, to be called on each pass of loop()
+   *
+   */
+  static void proceed()
+  {
+    const uint16_t day{ mainsClock.get_dayCount() };
+    if (day != lastDay)
+    {
+      lastDay = day;
+      record.today = EnergyTotals{};
+      save();
+    }
+
+    const uint32_t cycleCount{ getMainsCycleCount() };
+    if (cycleCount != lastCycleCount)
+    {
+      lastCycleCount = cycleCount;
+      lastCycle_ms = millis();
+      mainsLost = false;
+      return;
+    }
+
+    if (!mainsLost && millis() - lastCycle_ms > MAINS_LOSS_TIMEOUT_MS)
+    {
+      mainsLost = true;
+      readRegisters();
+      if (unsaved_Wh)
+      {
+        save();
+      }
+    }
+  }
+
+  /**
+   * @brief Energies since the first start-up
+   *
+   */
+  static const EnergyTotals &get_lifetime()
+  {
+    return record.lifetime;
+  }
+
+  /**
+   * @brief Energies since midnight
+   *
+   */
+  static const EnergyTotals &get_today()
+  {
+    return record.today;
+  }
+
+private:
+  /**
+   * @brief Count the energies added to the Wh registers of the ISR since the previous call
+   *
+   */
+  static void readRegisters()
+  {
+    const uint8_t oldSREG{ SREG };
+    cli();
+    const uint16_t diverted_Wh{ divertedEnergyTotal_Wh };
+    const uint16_t imported_Wh{ importedEnergyTotal_Wh };
+    const uint16_t exported_Wh{ exportedEnergyTotal_Wh };
+    SREG = oldSREG;
+
+    if (diverted_Wh < lastDiverted_Wh)
+    {
+      lastDiverted_Wh = 0;  // the register has been cleared after a period of inactivity
+    }
+    add(&EnergyTotals::diverted_Wh, diverted_Wh - lastDiverted_Wh);
+    add(&EnergyTotals::imported_Wh, imported_Wh - lastImported_Wh);
+    add(&EnergyTotals::exported_Wh, exported_Wh - lastExported_Wh);
+
+    lastDiverted_Wh = diverted_Wh;
+    lastImported_Wh = imported_Wh;
+    lastExported_Wh = exported_Wh;
+  }
+
+  /**
+   * @brief Add some energy to a counter, for today and for the lifetime
+   *
+   */
+  static void add(uint32_t EnergyTotals::*counter, uint16_t energy_Wh)
+  {
+    record.today.*counter += energy_Wh;
+    record.lifetime.*counter += energy_Wh;
+    unsaved_Wh += energy_Wh;
+  }
+
+  /**
+   * @brief Save the counters into the next slot
+   *
+   */
+  static void save()
+  {
+    EnergySlots::save(record);
+    unsaved_Wh = 0;
+  }
+
+  static inline EnergyRecord record; /**< the counters */
+
+  static inline uint16_t lastDiverted_Wh{ 0 }; /**< value of divertedEnergyTotal_Wh at the previous read */
+  static inline uint16_t lastImported_Wh{ 0 }; /**< value of importedEnergyTotal_Wh at the previous read */
+  static inline uint16_t lastExported_Wh{ 0 }; /**< value of exportedEnergyTotal_Wh at the previous read */
+  static inline uint16_t unsaved_Wh{ 0 };      /**< energy counted since the last save */
+  static inline uint16_t lastDay{ 0 };         /**< value of the day count at the previous call */
+
+  static inline uint32_t lastCycleCount{ 0 }; /**< mains cycle count at the previous call */
+  static inline uint32_t lastCycle_ms{ 0 };   /**< time of the last mains cycle */
+  static inline bool mainsLost{ false };      /**< true while no mains cycle is seen */
+};
+
+inline EnergyCounters energyCounters; /**< persistent energy counters */
+
+#endif /* UTILS_ENERGY_H */
@@ -0,0 +1,198 @@
+/**
+ * @file utils_json.h
+ * @author Frédéric Metrich (frederic.metrich@live.fr)
+ * @brief Zero-allocation streaming JSON writer
+ * @version 0.1
+ * @date 2024-11-22
+ *
+ * @copyright Copyright (c) 2024
+ *
+ * @section description Description
+ * The JSON text is written straight to the output, there's no document in RAM.
+ * Keys are flash-strings and numbers are printed with integer math only:
+ * fixed-point values (x100) get their decimal point inserted, no 'float' is involved.
+ *
+ * Since the writer only keeps a 'need comma' flag, it can also be re-created in the
+ * middle of a document (see the constructor), which allows a document to be produced
+ * in several pieces.
+ */
+
+#ifndef UTILS_JSON_H
+#define UTILS_JSON_H
+
+#include <Arduino.h>
+
+#include "FastDivision.h"
+
+/**
+ * @brief Streaming JSON writer
+ *
+ */
+class JsonWriter
+{
+public:
+  /**
+   * @brief Construct a new Json Writer object
+   *
+   * @param _out The output
+   * @param _continuation true if an element has already been written at the current level
+   */
+  explicit JsonWriter(Print &_out, bool _continuation = false)
+    : out{ _out }, needComma{ _continuation }
+  {
+  }
+
+  /**
+   * @brief Open an object
+   *
+   */
+  void beginObject()
+  {
+    separator();
+    out.write('{');
+    needComma = false;
+  }
+
+  /**
+   * @brief Close the current object
+   *
+   */
+  void endObject()
+  {
+    out.write('}');
+    needComma = true;
+  }
+
+  /**
+   * @brief Open an array as member of the current object
+   *
+   * @param key The name of the member
+   */
+  void beginArray(const __FlashStringHelper *key)
+  {
+    name(key);
+    out.write('[');
+    needComma = false;
+  }
+
+  /**
+   * @brief Close the current array
+   *
+   */
+  void endArray()
+  {
+    out.write(']');
+    needComma = true;
+  }
+
+  /**
+   * @brief Write the name of a member
+   *
+   * @param key The name
+   */
+  void name(const __FlashStringHelper *key)
+  {
+    separator();
+    out.write('"');
+    out.print(key);
+    out.write('"');
+    out.write(':');
+    needComma = false;
+  }
+
+  /**
+   * @brief Write an integer value
+   *
+   * @param v The value
+   */
+  void value(int32_t v)
+  {
+    separator();
+    out.print(v);
+    needComma = true;
+  }
+
+  /**
+   * @brief Write a fixed-point value with 2 decimals
+   * @details 23012 is written as 230.12, -5 as -0.05
+   *
+   * @param v_x100 The value x 100
+   */
+  void value_x100(int32_t v_x100)
+  {
+    separator();
+
+    if (v_x100 < 0)
+    {
+      out.write('-');
+      v_x100 = -v_x100;
+    }
+
+    uint32_t integral;
+    uint8_t hundredths;
+    uint8_t tenths;
+
+    divmod10(static_cast< uint32_t >(v_x100), integral, hundredths);
+    divmod10(integral, integral, tenths);
+
+    out.print(integral);
+    out.write('.');
+    out.write('0' + tenths);
+    out.write('0' + hundredths);
+
+    needComma = true;
+  }
+
+  /**
+   * @brief Write 'null'
+   *
+   */
+  void null()
+  {
+    separator();
+    out.print(F("null"));
+    needComma = true;
+  }
+
+  /**
+   * @brief Write an integer member
+   *
+   * @param key The name of the member
+   * @param v The value
+   */
+  void member(const __FlashStringHelper *key, int32_t v)
+  {
+    name(key);
+    value(v);
+  }
+
+  /**
+   * @brief Write a fixed-point member with 2 decimals
+   *
+   * @param key The name of the member
+   * @param v_x100 The value x 100
+   */
+  void member_x100(const __FlashStringHelper *key, int32_t v_x100)
+  {
+    name(key);
+    value_x100(v_x100);
+  }
+
+private:
+  /**
+   * @brief Write a comma if an element has already been written at this level
+   *
+   */
+  void separator()
+  {
+    if (needComma)
+    {
+      out.write(',');
+    }
+  }
+
+  Print &out;     /**< The output */
+  bool needComma; /**< true if the next element needs a leading comma */
+};
+
+#endif /* UTILS_JSON_H */
@@ -7,6 +7,18 @@
  * 
  * @copyright Copyright (c) 2024
  * 
+ * @section description Description
+ * The display is a dashboard of several pages:
+ *  - ENERGY: diverted energy of the day (large digits)
+ *  - POWER: grid power, diverted power, voltage and tariff
+ *  - METER: energy imported from and exported to the grid today
+ *  - LOADS: duty of each load over the last datalog period, state of the relays
+ *  - TEMPERATURES: one line per sensor (only with temperature sensing)
+ *
+ * All pages are rendered from a small cache of metrics, updated once per datalog period.
+ * Only the fields which have changed since the last update are redrawn, so a typical
+ * update sends a few characters over I2C. The whole page is only drawn when switching page,
+ * which happens every OLED_PAGE_PERIOD_IN_SECONDS or when oledPagePin is pulled LOW.
  */
 
 #ifndef UTILS_OLED_H
@@ -15,9 +27,15 @@
 #include <Arduino.h>
 #include <U8g2lib.h>
 
+#include "config.h"
+#include "constants.h"
+#include "processing.h"
 #include "type_traits.hpp"
 #include "FastDivision.h"
 #include "types.h"
+#include "utils_bcd.h"
+#include "utils_energy.h"
+#include "utils_twi.h"
 
 // Declaration for an SSD1306 display connected to I2C (SDA, SCL pins)
 // The pins for I2C are defined by the Wire-library.
@@ -63,12 +81,26 @@ public:
   void drawTile(uint8_t, uint8_t, uint8_t, uint8_t *) {}
 };
 
-conditional< TYPE_OF_DISPLAY == DisplayType::OLED, U8X8_SSD1306_128X64_NONAME_HW_I2C, u8x8_fake >::type u8x8(/* reset=*/U8X8_PIN_NONE); /**< The OLED display object */
+conditional< TYPE_OF_DISPLAY == DisplayType::OLED, U8X8_SSD1306_128X64_NONAME_ASYNC_I2C, u8x8_fake >::type u8x8(/* reset=*/U8X8_PIN_NONE); /**< The OLED display object */
+
+#ifdef OLED_PRESENT
+/**
+ * @brief Interrupt Service Routine - TWI, sends the next byte to the OLED display
+ * @details Only built with OLED_PRESENT, otherwise the TWI stays free for Wire.
+ *          One byte per interrupt, a few dozen cycles.
+ *
+ * @ingroup OLEDDisplay
+ */
+ISR(TWI_vect)
+{
+  AsyncTWI::proceed();
+}
+#endif
 
 inline constexpr uint8_t LOGO_WIDTH{ 72 };  /**< The width of the object, in pixel */
 inline constexpr uint8_t LOGO_HEIGHT{ 64 }; /**< The Height of the object, in pixel */
 
-const unsigned char logo_xbm[] U8X8_PROGMEM = {
+inline constexpr unsigned char logo_xbm[] = {
   0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
   0xef, 0xbf, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xef, 0xbf, 0xff,
   0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xcf, 0x9f, 0xff, 0xff, 0xff, 0xff,
@@ -117,66 +149,80 @@ const unsigned char logo_xbm[] U8X8_PROGMEM = {
   0xff, 0xff, 0xff, 0xff, 0x3f, 0xfc, 0xc3, 0xff, 0xff, 0xff, 0xff, 0xff,
   0xff, 0x1f, 0xf8, 0x87, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x3f, 0xfc,
   0x0f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
-}; /**< The xml object */
+}; /**< The xbm object, only used at compile time */
 
-#if !defined(__DOXYGEN__)
-inline uint8_t *get_tile_from_xbm(uint8_t, uint8_t, uint8_t, const unsigned char *) __attribute__((always_inline));
-#endif
+/**
+ * @brief Tiles of a bitmap, in the format of the SSD1306
+ * @details Each byte is one column of 8 pixels (LSB at the top), so a row of tiles
+ *          can be sent as is with a single drawTile().
+ *
+ * @tparam W Width of the bitmap, in pixel
+ * @tparam H Height of the bitmap, in pixel
+ */
+template< uint8_t W, uint8_t H > struct TileMap
+{
+  uint8_t rows[H >> 3][W]; /**< the columns of each row of tiles */
+};
 
 /**
- * @brief Get the tile from xbm object
- * 
- * @param tx Relative x position of the tile
- * @param ty Relative y position of the tile
- * @param xbm_byte_width Width of the xbm object
+ * @brief Transpose a xbm object into tiles at compile time
+ * @details In a xbm object, each byte is 8 horizontal pixels (LSB on the left).
+ *
+ * @tparam W Width of the bitmap, in pixel
+ * @tparam H Height of the bitmap, in pixel
+ * @tparam N Size of the xbm object
  * @param xbm The xbm object
- * @return uint8_t* 
- * 
+ * @return constexpr TileMap< W, H > The tiles
+ *
  * @ingroup OLEDDisplay
  */
-uint8_t *get_tile_from_xbm(uint8_t tx, uint8_t ty, uint8_t xbm_byte_width, const unsigned char *xbm)
+template< uint8_t W, uint8_t H, size_t N > constexpr TileMap< W, H > xbmToTiles(const unsigned char (&xbm)[N])
 {
-  uint8_t d[8];
-  const auto *p{ xbm + tx + xbm_byte_width * (ty << 3) };
+  static_assert(!(W & 7) && !(H & 7), "The size of the bitmap must be a multiple of 8 !");
+  static_assert(N == (W >> 3) * H, "The size of the xbm object does not match the size of the bitmap !");
 
-  // Clear the tile buffer
-  memset(d, 0, sizeof(d));
+  TileMap< W, H > tiles{};
 
-  for (uint8_t i = 0; i < 8; ++i)
+  for (uint8_t ty = 0; ty < (H >> 3); ++ty)
   {
-    uint8_t b = u8x8_pgm_read(p);
-    for (uint8_t bit = 0; bit < 8; ++bit)
+    for (uint8_t x = 0; x < W; ++x)
     {
-      if (b & (1 << bit))
+      uint8_t column{ 0 };
+      for (uint8_t row = 0; row < 8; ++row)
       {
-        d[bit] |= (1 << i);
+        if (xbm[(W >> 3) * ((ty << 3) + row) + (x >> 3)] & (1 << (x & 7)))
+        {
+          column |= 1 << row;
+        }
       }
+      tiles.rows[ty][x] = column;
     }
-    p += xbm_byte_width;
   }
-  return d;
+  return tiles;
 }
 
+inline constexpr TileMap< LOGO_WIDTH, LOGO_HEIGHT > logo_tiles PROGMEM{ xbmToTiles< LOGO_WIDTH, LOGO_HEIGHT >(logo_xbm) }; /**< The logo, ready to be sent */
+
 /**
- * @brief Draw the xbm on the OLED display
- * 
- * @param tx x position for drawing the xbm
- * @param ty y position for drawing the xbm
- * @param xbm_width Width of the xbm
- * @param xbm_height Height of the xbm
- * @param xbm The xbm object
- * 
+ * @brief Draw a tile map on the OLED display
+ * @details The tiles are sent one row at a time.
+ *
+ * @tparam W Width of the bitmap, in pixel
+ * @tparam H Height of the bitmap, in pixel
+ * @param tx x position for drawing the bitmap (in tiles)
+ * @param ty y position for drawing the bitmap (in tiles)
+ * @param tiles The tile map, in flash
+ *
  * @ingroup OLEDDisplay
  */
-void u8x8_draw_xbm(uint8_t tx, uint8_t ty, uint8_t xbm_width, uint8_t xbm_height, const unsigned char *xbm)
+template< uint8_t W, uint8_t H > void u8x8_draw_tiles(uint8_t tx, uint8_t ty, const TileMap< W, H > &tiles)
 {
-  for (uint8_t y = 0; y < (xbm_height >> 3); ++y)
+  uint8_t row[W];
+
+  for (uint8_t y = 0; y < (H >> 3); ++y)
   {
-    for (uint8_t x = 0; x < (xbm_width >> 3); ++x)
-    {
-      const auto tile{ get_tile_from_xbm(x, y, xbm_width >> 3, xbm) };
-      u8x8.drawTile(tx + x, ty + y, 1, tile);
-    }
+    memcpy_P(row, tiles.rows[y], W);
+    u8x8.drawTile(tx, ty + y, W >> 3, row);
   }
 }
 
@@ -199,18 +245,120 @@ void setupOLED()
 
     u8x8.noInverse();
 
-    u8x8_draw_xbm((u8x8.getCols() - (LOGO_WIDTH >> 3)) >> 1, (u8x8.getRows() - (LOGO_HEIGHT >> 3)) >> 1, LOGO_WIDTH, LOGO_HEIGHT, logo_xbm);
+    if (oledPagePin != 0xff)
+    {
+      pinMode(oledPagePin, INPUT_PULLUP);  // set as input & enable the internal pullup resistor
+    }
+
+    u8x8_draw_tiles((u8x8.getCols() - (LOGO_WIDTH >> 3)) >> 1, (u8x8.getRows() - (LOGO_HEIGHT >> 3)) >> 1, logo_tiles);
+  }
+}
+
+inline constexpr uint8_t OLED_PAGE_PERIOD_IN_SECONDS{ 10 }; /**< the page changes after this period, 0 to change it only with oledPagePin */
+inline constexpr uint8_t OLED_LIST_LINES{ 6 };              /**< lines of the list pages, the 2 last rows are kept for the watchdog */
+inline constexpr uint8_t OLED_FIELD_WIDTH{ 7 };             /**< width of a value, in characters */
+
+inline constexpr uint8_t VALUE_LENGTH{ 5 };     /**< number of characters of the value, "1.234" or "12.34" */
+inline constexpr uint8_t VALUE_FONT_WIDTH{ 3 }; /**< width of one character of the value, in tiles */
+
+static_assert(NO_OF_DUMPLOADS <= 8, "******** The OLED dashboard supports up to 8 loads ! ********");
+static_assert(relays.get_size() <= 8, "******** The OLED dashboard supports up to 8 relays ! ********");
+
+/** Pages of the dashboard */
+enum class OLEDPages : uint8_t
+{
+  ENERGY,       /**< diverted energy */
+  POWER,        /**< grid/diverted power, voltage, tariff */
+  METER,        /**< imported/exported energy */
+  LOADS,        /**< duty of the loads, state of the relays */
+  TEMPERATURES  /**< temperatures */
+};
+
+inline constexpr uint8_t OLED_NO_OF_PAGES{ TEMP_SENSOR_PRESENT ? 5 : 4 }; /**< number of pages */
+
+/** Fields of the dashboard, one dirty bit each */
+enum DashboardFields : uint8_t
+{
+  FIELD_ENERGY,   /**< diverted energy */
+  FIELD_GRID,     /**< grid power */
+  FIELD_DIVERTED, /**< diverted power */
+  FIELD_VRMS,     /**< voltage */
+  FIELD_TARIFF,   /**< tariff */
+  FIELD_RELAYS,   /**< state of the relays */
+  FIELD_IMPORTED, /**< imported energy */
+  FIELD_EXPORTED  /**< exported energy */
+};
+
+static_assert(FIELD_EXPORTED < 8, "******** The dirty bits of the dashboard fields don't fit in 8 bits ! ********");
+
+/**
+ * @brief Cached metrics of the dashboard
+ * @details Each field has a dirty bit, set when the value changes.
+ *          Loads and temperatures have one dirty bit per element.
+ *
+ */
+struct DashboardMetrics
+{
+  uint16_t divertedEnergy_Wh;                              /**< diverted energy */
+  uint32_t importedEnergy_Wh;                              /**< energy imported today */
+  uint32_t exportedEnergy_Wh;                              /**< energy exported today */
+  int16_t powerGrid;                                       /**< grid power (W) */
+  int16_t powerDiverted;                                   /**< diverted power (W) */
+  int16_t Vrms_L_x100;                                     /**< voltage (in 100th of Volt) */
+  bool offPeak;                                            /**< true during off-peak */
+  uint8_t relaysON;                                        /**< bit i is set when relay #i is ON */
+  uint8_t loadDuty[NO_OF_DUMPLOADS];                       /**< ON-time of each load (in %) */
+  int16_t temperature_x100[temperatureSensing.get_size()]; /**< temperatures (in 100th of °C) */
+
+  uint8_t dirtyFields;       /**< one bit per DashboardFields */
+  uint8_t dirtyLoads;        /**< one bit per load */
+  uint8_t dirtyTemperatures; /**< one bit per sensor */
+};
+
+DashboardMetrics dashboard;                 /**< metrics shown on the OLED display */
+OLEDPages currentPage{ OLEDPages::ENERGY }; /**< page on the screen */
+
+char valueOnScreen[VALUE_LENGTH]; /**< shadow of the characters of the value on the screen, 0 when not drawn */
+
+/**
+ * @brief Store a new value in the cache, and mark it dirty if it has changed
+ *
+ * @param field The cached field
+ * @param value The new value
+ * @param dirty The dirty bits
+ * @param bit The bit of the field
+ */
+template< typename T > void updateField(T &field, const T value, uint8_t &dirty, const uint8_t bit)
+{
+  if (field != value)
+  {
+    field = value;
+    bit_set(dirty, bit);
   }
 }
 
+/**
+ * @brief Mark all the fields dirty, so that the next render draws everything
+ *
+ */
+void invalidateDashboard()
+{
+  dashboard.dirtyFields = 0xff;
+  dashboard.dirtyLoads = 0xff;
+  dashboard.dirtyTemperatures = 0xff;
+  memset(valueOnScreen, 0, sizeof(valueOnScreen));
+}
+
 /**
  * @brief Clear the display
+ * @details The shadow is reset as well, so that everything gets redrawn on the next update.
  * 
  * @ingroup OLEDDisplay
  */
 void clearDisplay()
 {
   u8x8.clearDisplay();
+  invalidateDashboard();
 }
 
 /**
@@ -223,6 +371,7 @@ void updateWatchdog()
   if constexpr (TYPE_OF_DISPLAY == DisplayType::OLED)
   {
     static bool watchdogState{ false };  // State of the blinking LED
+    static uint8_t blankTiles[16]{};     // 2 tiles, the font of the page may be smaller than the symbol
 
     // Toggle the watchdog state
     watchdogState ^= true;
@@ -234,33 +383,363 @@ void updateWatchdog()
     }
     else
     {
-      u8x8.drawString(0, 6, "  ");
+      u8x8.drawTile(0, 6, 2, blankTiles);
+      u8x8.drawTile(0, 7, 2, blankTiles);
     }
   }
 }
 
 /**
- * @brief Update the OLED display with the given value
- * 
- * @param value The value to display
- * 
+ * @brief Draw a right-aligned value, padded with spaces to OLED_FIELD_WIDTH
+ *
+ * @param col Column of the first character
+ * @param row Row
+ * @param value The value, scaled by 10^decimals
+ * @param decimals The number of decimals
+ *
  * @ingroup OLEDDisplay
  */
-void updateOLED(uint16_t value)
+void drawField(uint8_t col, uint8_t row, int16_t value, uint8_t decimals)
 {
-  if constexpr (TYPE_OF_DISPLAY == DisplayType::OLED)
+  char buffer[BCD_DIGITS + 3];
+  char line[OLED_FIELD_WIDTH + 1];
+
+  const uint8_t len{ formatFixedPoint(buffer, value < 0 ? static_cast< uint16_t >(0U - static_cast< uint16_t >(value)) : value, decimals, value < 0) };
+  const uint8_t pad{ static_cast< uint8_t >(OLED_FIELD_WIDTH - len) };
+
+  memset(line, ' ', pad);
+  memcpy(line + pad, buffer, len + 1);
+  u8x8.drawString(col, row, line);
+}
+
+/**
+ * @brief Render the ENERGY page
+ * @details Each character of the value is a block of 3x6 tiles. Only the characters which
+ *          differ from the shadow are sent over I2C, and the unit only after a clear.
+ *
+ */
+void renderEnergyPage()
+{
+  if (!bit_read(dashboard.dirtyFields, FIELD_ENERGY))
   {
-    static char buffer[6];  // Buffer to hold the formatted string
+    return;
+  }
 
-    // Set the font and format the value as a float with max 3 decimal places and 4 digits wide
-    u8x8.setFont(u8x8_font_inb33_3x6_n);
-    dtostrf(value * 0.001F, 4, 3, buffer);
-    u8x8.drawString(0, 0, buffer);
+  const auto value{ dashboard.divertedEnergy_Wh };
+  char buffer[BCD_DIGITS + 3];  // Buffer to hold the formatted string
 
+  // format the value in kWh, with 3 decimal places (2 above 10 kWh): always VALUE_LENGTH characters
+  if (value < 10000)
+  {
+    formatFixedPoint(buffer, value, 3);
+  }
+  else
+  {
+    formatFixedPoint(buffer, divu10(value), 2);
+  }
+
+  if (!valueOnScreen[0])
+  {
     // Set the font and draw the unit
     u8x8.setFont(u8x8_font_7x14B_1x2_r);
     u8x8.drawString(12, 6, "kWh");
   }
+
+  u8x8.setFont(u8x8_font_inb33_3x6_n);
+  for (uint8_t i = 0; i < VALUE_LENGTH; ++i)
+  {
+    if (buffer[i] != valueOnScreen[i])
+    {
+      u8x8.drawGlyph(i * VALUE_FONT_WIDTH, 0, buffer[i]);
+      valueOnScreen[i] = buffer[i];
+    }
+  }
+}
+
+/**
+ * @brief Render the POWER page
+ *
+ * @param full true to draw the labels as well
+ */
+void renderPowerPage(bool full)
+{
+  u8x8.setFont(u8x8_font_7x14B_1x2_r);
+
+  if (full)
+  {
+    u8x8.drawString(0, 0, "Grid");
+    u8x8.drawString(15, 0, "W");
+    u8x8.drawString(0, 2, "Div.");
+    u8x8.drawString(15, 2, "W");
+    u8x8.drawString(0, 4, "Vrms");
+    u8x8.drawString(15, 4, "V");
+  }
+
+  if (bit_read(dashboard.dirtyFields, FIELD_GRID))
+  {
+    drawField(7, 0, dashboard.powerGrid, 0);
+  }
+  if (bit_read(dashboard.dirtyFields, FIELD_DIVERTED))
+  {
+    drawField(7, 2, dashboard.powerDiverted, 0);
+  }
+  if (bit_read(dashboard.dirtyFields, FIELD_VRMS))
+  {
+    drawField(7, 4, dashboard.Vrms_L_x100, 2);
+  }
+  if constexpr (DUAL_TARIFF)
+  {
+    if (bit_read(dashboard.dirtyFields, FIELD_TARIFF))
+    {
+      u8x8.drawString(6, 6, dashboard.offPeak ? "off-peak" : "    peak");
+    }
+  }
+}
+
+/**
+ * @brief Draw an energy in kWh with 1 decimal
+ *
+ * @param row Row
+ * @param energy_Wh The energy
+ */
+void drawEnergyField(uint8_t row, uint32_t energy_Wh)
+{
+  const uint32_t energy_x10kWh{ energy_Wh / 100 };
+  drawField(5, row, energy_x10kWh > INT16_MAX ? INT16_MAX : static_cast< int16_t >(energy_x10kWh), 1);
+}
+
+/**
+ * @brief Render the METER page
+ *
+ * @param full true to draw the labels as well
+ */
+void renderMeterPage(bool full)
+{
+  u8x8.setFont(u8x8_font_7x14B_1x2_r);
+
+  if (full)
+  {
+    u8x8.drawString(0, 0, "Imp.");
+    u8x8.drawString(13, 0, "kWh");
+    u8x8.drawString(0, 2, "Exp.");
+    u8x8.drawString(13, 2, "kWh");
+  }
+
+  if (bit_read(dashboard.dirtyFields, FIELD_IMPORTED))
+  {
+    drawEnergyField(0, dashboard.importedEnergy_Wh);
+  }
+  if (bit_read(dashboard.dirtyFields, FIELD_EXPORTED))
+  {
+    drawEnergyField(2, dashboard.exportedEnergy_Wh);
+  }
+}
+
+/**
+ * @brief Render the LOADS page
+ *
+ * @param full true to draw the labels as well
+ */
+void renderLoadsPage(bool full)
+{
+  u8x8.setFont(u8x8_font_chroma48medium8_r);
+
+  uint8_t line{ 0 };
+  for (uint8_t i = 0; i < NO_OF_DUMPLOADS && line < OLED_LIST_LINES; ++i, ++line)
+  {
+    if (full)
+    {
+      u8x8.drawString(0, line, "Load");
+      u8x8.drawGlyph(5, line, '1' + i);
+      u8x8.drawGlyph(15, line, '%');
+    }
+    if (bit_read(dashboard.dirtyLoads, i))
+    {
+      drawField(7, line, dashboard.loadDuty[i], 0);
+    }
+  }
+
+  if constexpr (RELAY_DIVERSION)
+  {
+    for (uint8_t i = 0; i < relays.get_size() && line < OLED_LIST_LINES; ++i, ++line)
+    {
+      if (full)
+      {
+        u8x8.drawString(0, line, "Relay");
+        u8x8.drawGlyph(6, line, '1' + i);
+      }
+      if (bit_read(dashboard.dirtyFields, FIELD_RELAYS))
+      {
+        u8x8.drawString(13, line, bit_read(dashboard.relaysON, i) ? " ON" : "OFF");
+      }
+    }
+  }
+}
+
+/**
+ * @brief Render the TEMPERATURES page
+ *
+ * @param full true to draw the labels as well
+ */
+void renderTemperaturesPage(bool full)
+{
+  u8x8.setFont(u8x8_font_chroma48medium8_r);
+
+  for (uint8_t i = 0; i < temperatureSensing.get_size() && i < OLED_LIST_LINES; ++i)
+  {
+    if (full)
+    {
+      u8x8.drawGlyph(0, i, 'T');
+      u8x8.drawGlyph(1, i, '1' + i);
+      u8x8.drawGlyph(15, i, 'C');
+    }
+    if (bit_read(dashboard.dirtyTemperatures, i))
+    {
+      const auto temperature_x100{ dashboard.temperature_x100[i] };
+      if ((OUTOFRANGE_TEMPERATURE == temperature_x100) || (DEVICE_DISCONNECTED_RAW == temperature_x100))
+      {
+        u8x8.drawString(7, i, "   ----");
+      }
+      else
+      {
+        drawField(7, i, temperature_x100, 2);
+      }
+    }
+  }
+}
+
+/**
+ * @brief Render the current page
+ * @details Only the dirty fields are drawn, unless the page has just been cleared.
+ *
+ * @param full true to draw the labels as well
+ */
+void renderPage(bool full)
+{
+  switch (currentPage)
+  {
+    case OLEDPages::ENERGY:
+      renderEnergyPage();
+      break;
+    case OLEDPages::POWER:
+      renderPowerPage(full);
+      break;
+    case OLEDPages::METER:
+      renderMeterPage(full);
+      break;
+    case OLEDPages::LOADS:
+      renderLoadsPage(full);
+      break;
+    case OLEDPages::TEMPERATURES:
+      renderTemperaturesPage(full);
+      break;
+  }
+
+  dashboard.dirtyFields = 0;
+  dashboard.dirtyLoads = 0;
+  dashboard.dirtyTemperatures = 0;
+}
+
+/**
+ * @brief Switch the OLED display to the next page
+ * @details To be called when at least one mains cycle has elapsed since the previous call.
+ *          The page changes every OLED_PAGE_PERIOD_IN_SECONDS, or on a falling edge of oledPagePin.
+ *
+ * @param elapsedCycles Number of mains cycles since the previous call
+ *
+ * @ingroup OLEDDisplay
+ */
+void proceedOLEDPages(uint16_t elapsedCycles)
+{
+  if constexpr (TYPE_OF_DISPLAY == DisplayType::OLED)
+  {
+    static uint16_t pageTimer{ 0 };
+    static uint8_t pinState{ HIGH };
+
+    bool nextPage{ false };
+
+    if constexpr (OLED_PAGE_PERIOD_IN_SECONDS != 0)
+    {
+      pageTimer += elapsedCycles;
+      if (pageTimer >= OLED_PAGE_PERIOD_IN_SECONDS * SUPPLY_FREQUENCY)
+      {
+        nextPage = true;
+      }
+    }
+
+    if (oledPagePin != 0xff)
+    {
+      const auto pinNewState{ getPinState(oledPagePin) };
+      if (pinState != pinNewState)
+      {
+        pinState = pinNewState;
+        nextPage |= (pinNewState == LOW);
+      }
+    }
+
+    if (!nextPage)
+    {
+      return;
+    }
+
+    pageTimer = 0;
+    currentPage = static_cast< OLEDPages >((static_cast< uint8_t >(currentPage) + 1) % OLED_NO_OF_PAGES);
+
+    clearDisplay();
+    renderPage(true);
+  }
+}
+
+/**
+ * @brief Update the cached metrics and redraw what has changed on the current page
+ * @details To be called once per datalog period.
+ * 
+ * @param bOffPeak true during off-peak
+ * 
+ * @ingroup OLEDDisplay
+ */
+void updateOLED(bool bOffPeak)
+{
+  if constexpr (TYPE_OF_DISPLAY == DisplayType::OLED)
+  {
+    updateField(dashboard.divertedEnergy_Wh, static_cast< uint16_t >(divertedEnergyTotal_Wh), dashboard.dirtyFields, FIELD_ENERGY);
+    updateField(dashboard.powerGrid, tx_data.powerGrid, dashboard.dirtyFields, FIELD_GRID);
+    updateField(dashboard.powerDiverted, tx_data.powerDiverted, dashboard.dirtyFields, FIELD_DIVERTED);
+    updateField(dashboard.Vrms_L_x100, tx_data.Vrms_L_x100, dashboard.dirtyFields, FIELD_VRMS);
+    updateField(dashboard.offPeak, bOffPeak, dashboard.dirtyFields, FIELD_TARIFF);
+    updateField(dashboard.importedEnergy_Wh, energyCounters.get_today().imported_Wh, dashboard.dirtyFields, FIELD_IMPORTED);
+    updateField(dashboard.exportedEnergy_Wh, energyCounters.get_today().exported_Wh, dashboard.dirtyFields, FIELD_EXPORTED);
+
+    uint8_t i{ NO_OF_DUMPLOADS };
+    do
+    {
+      --i;
+      const auto duty{ static_cast< uint8_t >(copyOf_countLoadON[i] * 100UL / DATALOG_PERIOD_IN_MAINS_CYCLES) };
+      updateField(dashboard.loadDuty[i], duty, dashboard.dirtyLoads, i);
+    } while (i);
+
+    if constexpr (RELAY_DIVERSION)
+    {
+      uint8_t relaysON{ 0 };
+      for (uint8_t idx = 0; idx < relays.get_size(); ++idx)
+      {
+        if (relays.get_relay(idx).isRelayON())
+        {
+          bit_set(relaysON, idx);
+        }
+      }
+      updateField(dashboard.relaysON, relaysON, dashboard.dirtyFields, FIELD_RELAYS);
+    }
+
+#ifdef TEMP_ENABLED
+    for (uint8_t idx = 0; idx < temperatureSensing.get_size(); ++idx)
+    {
+      updateField(dashboard.temperature_x100[idx], tx_data.temperature_x100[idx], dashboard.dirtyTemperatures, idx);
+    }
+#endif
+
+    renderPage(false);
+  }
 }
 
 #endif /* UTILS_OLED_H */
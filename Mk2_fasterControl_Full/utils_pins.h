@@ -189,4 +189,141 @@ inline constexpr bool getPinState(const uint8_t pin)
                                                       : bit_read(PINC, pin - 14);
 }
 
+/**
+ * @brief One byte per I/O port, bit n of a port byte is pin n of that port
+ * @details Pins 0..7 are on PORTD, pins 8..13 on PORTB and pins 14..19 on PORTC.
+ *
+ */
+struct PortValues
+{
+  uint8_t d; /**< PORTD */
+  uint8_t b; /**< PORTB */
+  uint8_t c; /**< PORTC */
+};
+
+/**
+ * @brief Set the bit of the given pin in the port bytes
+ *
+ * @param values The port bytes
+ * @param pin The pin [0..19]
+ */
+constexpr void bit_set(PortValues &values, const uint8_t pin)
+{
+  if (pin < 8)
+  {
+    bit_set(values.d, pin);
+  }
+  else if (pin < 14)
+  {
+    bit_set(values.b, pin - 8);
+  }
+  else
+  {
+    bit_set(values.c, pin - 14);
+  }
+}
+
+/**
+ * @brief Port masks of a list of pins
+ *
+ * @tparam N Number of pins
+ * @param pins The pins
+ * @return constexpr PortValues The bits of the pins on each port
+ */
+template< size_t N > constexpr PortValues portMasks(const uint8_t (&pins)[N])
+{
+  PortValues masks{};
+  for (const auto pin : pins)
+  {
+    bit_set(masks, pin);
+  }
+  return masks;
+}
+
+/**
+ * @brief Spread a bit pattern over a list of pins
+ *
+ * @tparam N Number of pins
+ * @param pins The pins
+ * @param pattern Bit i is the state of pins[i]
+ * @return constexpr PortValues The bits to be written on each port
+ */
+template< size_t N > constexpr PortValues portBits(const uint8_t (&pins)[N], const uint8_t pattern)
+{
+  PortValues values{};
+  for (uint8_t i = 0; i < N; ++i)
+  {
+    if (bit_read(pattern, i))
+    {
+      bit_set(values, pins[i]);
+    }
+  }
+  return values;
+}
+
+/**
+ * @brief Table of port bytes, to be computed at compile time
+ *
+ * @tparam N Number of entries
+ */
+template< size_t N > struct PortValuesTable
+{
+  PortValues values[N]; /**< port bytes of each entry */
+};
+
+/**
+ * @brief Compute the port bytes of a list of bit patterns
+ *
+ * @tparam N Number of patterns
+ * @tparam P Number of pins
+ * @param patterns The bit patterns, bit i is the state of pins[i]
+ * @param pins The pins
+ * @return constexpr PortValuesTable< N > The port bytes of each pattern
+ */
+template< size_t N, size_t P > constexpr PortValuesTable< N > makePortValuesTable(const uint8_t (&patterns)[N], const uint8_t (&pins)[P])
+{
+  PortValuesTable< N > table{};
+  for (uint8_t i = 0; i < N; ++i)
+  {
+    table.values[i] = portBits(pins, patterns[i]);
+  }
+  return table;
+}
+
+/**
+ * @brief Write the masked bits of the ports, the other bits are left untouched
+ * @details The bits are toggled through the PINx registers, so a concurrent change
+ *          of the other bits of the same port (from an ISR) is never lost.
+ *          With a mask known at compile time, unused ports are skipped.
+ *
+ * @param masks The bits to be written
+ * @param values The new state of these bits
+ */
+inline void writePorts(const PortValues &masks, const PortValues &values)
+{
+  if (masks.d)
+  {
+    PIND = (PORTD ^ values.d) & masks.d;
+  }
+  if (masks.b)
+  {
+    PINB = (PORTB ^ values.b) & masks.b;
+  }
+  if (masks.c)
+  {
+    PINC = (PORTC ^ values.c) & masks.c;
+  }
+}
+
+/**
+ * @brief Read port bytes from flash
+ *
+ * @param p Address of the port bytes in PROGMEM
+ * @return PortValues The port bytes
+ */
+inline PortValues readPortValues_P(const PortValues *p)
+{
+  return { pgm_read_byte(&p->d), pgm_read_byte(&p->b), pgm_read_byte(&p->c) };
+}
+
 #endif  // UTILS_PINS_H
@@ -20,6 +20,7 @@
 #include "movingAvg.h"
 #include "ewma_avg.hpp"
 #include "utils_pins.h"
+#include "utils_serial.h"
 
 /**
  * @brief Relay diversion config and engine
@@ -199,7 +200,7 @@ private:
 
     setPinON(relay_pin);
 
-    DBUGLN(F("Relay turned ON!"));
+    DBUGLN_Q(F("Relay turned ON!"));
 
     relayIsON = true;
     duration = 0;
@@ -221,7 +222,7 @@ private:
 
     setPinOFF(relay_pin);
 
-    DBUGLN(F("Relay turned OFF!"));
+    DBUGLN_Q(F("Relay turned OFF!"));
 
     relayIsON = false;
     duration = 0;
@@ -0,0 +1,236 @@
+/**
+ * @file utils_rf.h
+ * @author Frédéric Metrich (frederic.metrich@live.fr)
+ * @brief Non-blocking transmission through the RFM12B module
+ * @version 0.1
+ * @date 2024-11-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ * @section description Description
+ * The RF12 driver from JeeLib sends a packet byte by byte from its own interrupt (INT0).
+ * The only blocking part is the wait for a free channel, which is done here with
+ * a small state machine, advanced once per pass of loop():
+ *  - IDLE: nothing to send
+ *  - WAITING: a payload is queued, waiting for the channel to be free
+ *  - SENDING: the packet has been handed over to the driver, waiting for the end of the transmission
+ *
+ * No interrupt is ever disabled in this file.
+ * The INT0 handler of the driver is short compared to the ADC conversion time (104 µs),
+ * so a pending ADC interrupt is only delayed and no sample is lost.
+ */
+
+#ifndef UTILS_RF_H
+#define UTILS_RF_H
+
+#include <Arduino.h>
+
+#include "types.h"
+
+#ifdef RF_PRESENT
+inline constexpr bool RF_CHIP_PRESENT{ true }; /**< set it to 'true' if the RFM12B module is present */
+#include <JeeLib.h>                            // for the RFM12B module
+#else
+inline constexpr bool RF_CHIP_PRESENT{ false }; /**< set it to 'true' if the RFM12B module is present */
+#endif
+
+inline constexpr uint8_t RF_MAX_PAYLOAD_SIZE{ 66 };   /**< max payload size of the RF12 driver */
+inline constexpr uint16_t RF_SEND_TIMEOUT_MS{ 1000 }; /**< a queued payload is dropped if the channel is still busy after this delay */
+
+/** States of the transmitter */
+enum class RFStates : uint8_t
+{
+  IDLE,    /**< nothing to send */
+  WAITING, /**< payload queued, channel busy */
+  SENDING  /**< packet handed over to the driver */
+};
+
+/**
+ * @brief Non-blocking RFM12B transmitter
+ * @details The payload is copied when it is queued, so the caller's data can change
+ *          or go out of scope right away. The driver copies it again when the transmission starts.
+ *
+ * @tparam T Type of the payload, the copy takes sizeof(T) bytes of RAM
+ *
+ * @ingroup RF
+ */
+template< typename T >
+class RFTransmitter
+{
+  static_assert(sizeof(T) <= RF_MAX_PAYLOAD_SIZE, "******** RF payload is too large ! ********");
+
+public:
+  RFTransmitter() = delete;
+
+  /**
+   * @brief Construct a new RFTransmitter object
+   *
+   * @param _band The frequency band of the module
+   * @param _nodeID The node ID of the router
+   * @param _networkGroup The wireless network group, must be the same for all nodes
+   */
+  constexpr RFTransmitter(RFBands _band, uint8_t _nodeID, uint8_t _networkGroup)
+    : band{ _band }, nodeID{ _nodeID }, networkGroup{ _networkGroup }
+  {
+  }
+
+  /**
+   * @brief Get the node ID
+   *
+   * @return constexpr auto The node ID
+   */
+  constexpr auto get_nodeID() const
+  {
+    return nodeID;
+  }
+
+  /**
+   * @brief Get the network group
+   *
+   * @return constexpr auto The network group
+   */
+  constexpr auto get_networkGroup() const
+  {
+    return networkGroup;
+  }
+
+  /**
+   * @brief Get the current state of the transmitter
+   *
+   * @return RFStates The state
+   */
+  RFStates get_state() const
+  {
+    return state;
+  }
+
+  /**
+   * @brief Number of packets handed over to the driver since start-up
+   *
+   */
+  uint16_t get_sent() const
+  {
+    return sent;
+  }
+
+  /**
+   * @brief Number of payloads dropped since start-up
+   * @details A payload is dropped when it is replaced by a newer one before being sent,
+   *          or when the channel stays busy for more than RF_SEND_TIMEOUT_MS.
+   *
+   */
+  uint16_t get_dropped() const
+  {
+    return dropped;
+  }
+
+  /**
+   * @brief Initialize the RFM12B module
+   *
+   */
+  void initialize() const
+  {
+#ifdef RF_PRESENT
+    rf12_initialize(nodeID, static_cast< uint8_t >(band), networkGroup);
+#endif
+    state = RFStates::IDLE;
+  }
+
+  /**
+   * @brief Queue a payload for transmission
+   * @details The payload is copied. If a payload is still waiting for the channel, it is replaced by the new one.
+   *
+   * @param data The payload
+   */
+  void queue(const T &data) const
+  {
+    if (state == RFStates::WAITING)
+    {
+      ++dropped;
+    }
+
+    payload = data;
+    queuedAt = millis();
+    state = RFStates::WAITING;
+  }
+
+  /**
+   * @brief Advance the state machine
+   * @details To be called on each pass of loop(). It never waits.
+   *
+   */
+  void proceed() const
+  {
+#ifdef RF_PRESENT
+    rf12_recvDone();  // keeps the driver running (restarts reception after a transmission)
+
+    switch (state)
+    {
+      case RFStates::WAITING:
+        if (rf12_canSend())
+        {
+          rf12_sendStart(0, &payload, sizeof(T));
+          ++sent;
+          state = RFStates::SENDING;
+        }
+        else if (millis() - queuedAt > RF_SEND_TIMEOUT_MS)
+        {
+          ++dropped;
+          state = RFStates::IDLE;
+        }
+        break;
+
+      case RFStates::SENDING:
+        // the channel is available again once the packet has been sent
+        if (rf12_canSend())
+        {
+          state = RFStates::IDLE;
+        }
+        break;
+
+      default:
+        break;
+    }
+#endif
+  }
+
+  /**
+   * @brief Print the configuration of the RF module
+   *
+   */
+  void printConfiguration() const
+  {
+    Serial.println(F("\t*** RF configuration ***"));
+    Serial.print(F("\tNode ID: "));
+    Serial.println(nodeID);
+    Serial.print(F("\tNetwork group: "));
+    Serial.println(networkGroup);
+    Serial.print(F("\tBand: "));
+    switch (band)
+    {
+      case RFBands::RF_433MHZ:
+        Serial.println(F("433 MHz"));
+        break;
+      case RFBands::RF_868MHZ:
+        Serial.println(F("868 MHz"));
+        break;
+      case RFBands::RF_915MHZ:
+        Serial.println(F("915 MHz"));
+        break;
+    }
+  }
+
+private:
+  const RFBands band;         /**< frequency band */
+  const uint8_t nodeID;       /**< node ID of the router */
+  const uint8_t networkGroup; /**< wireless network group */
+
+  static inline T payload;                        /**< copy of the queued payload */
+  static inline uint32_t queuedAt{ 0 };           /**< time when the payload has been queued (in ms) */
+  static inline RFStates state{ RFStates::IDLE }; /**< current state */
+
+  static inline uint16_t sent{ 0 };    /**< number of sent packets */
+  static inline uint16_t dropped{ 0 }; /**< number of dropped payloads */
+};
+
+#endif /* UTILS_RF_H */
@@ -0,0 +1,140 @@
+/**
+ * @file utils_ringbuffer.h
+ * @author Frédéric Metrich (frederic.metrich@live.fr)
+ * @brief Fixed-capacity ring buffer for the data exchange between the ISR and loop()
+ * @version 0.1
+ * @date 2024-12-10
+ *
+ * @copyright Copyright (c) 2024
+ *
+ * @section description Description
+ * Single producer, single consumer, without lock: the producer only writes 'head',
+ * the consumer only writes 'tail'. Both indices are 8-bit, so they're read and written
+ * atomically on the AVR, and run freely: the number of elements is head - tail.
+ *
+ * The element is copied into the buffer before 'head' is published, and copied out before
+ * 'tail' is released. A compiler barrier keeps that order, the AVR has no other reordering.
+ *
+ * When the buffer is full, push() drops the new element and counts it.
+ *
+ * It only depends on <stdint.h>, so it's also tested on the host (test/native).
+ */
+
+#ifndef UTILS_RINGBUFFER_H
+#define UTILS_RINGBUFFER_H
+
+#include <stdint.h>
+
+/**
+ * @brief Fixed-capacity SPSC ring buffer
+ *
+ * @tparam T Type of the elements
+ * @tparam N Capacity, a power of 2 up to 128
+ */
+template< typename T, uint8_t N >
+class RingBuffer
+{
+  static_assert(N && !(N & (N - 1)), "******** The capacity of a ring buffer must be a power of 2 ! ********");
+  static_assert(N <= 128, "******** The capacity of a ring buffer must not exceed 128 ! ********");
+
+public:
+  /**
+   * @brief Add an element, from the producer side
+   *
+   * @param value The element
+   * @return true if the element has been added, false if the buffer is full
+   */
+  bool push(const T &value)
+  {
+    const uint8_t h{ head };
+    if (static_cast< uint8_t >(h - tail) >= N)
+    {
+      if (overflows != UINT8_MAX)
+      {
+        ++overflows;
+      }
+      return false;
+    }
+
+    buffer[h & MASK] = value;
+    barrier();
+    head = h + 1;
+    return true;
+  }
+
+  /**
+   * @brief Remove the oldest element, from the consumer side
+   *
+   * @param value Receives the element
+   * @return true if an element has been removed, false if the buffer is empty
+   */
+  bool pop(T &value)
+  {
+    const uint8_t t{ tail };
+    if (t == head)
+    {
+      return false;
+    }
+
+    barrier();
+    value = buffer[t & MASK];
+    barrier();
+    tail = t + 1;
+    return true;
+  }
+
+  /**
+   * @brief Return true if there's no element, from either side
+   *
+   */
+  bool empty() const
+  {
+    return head == tail;
+  }
+
+  /**
+   * @brief Number of elements, from either side
+   *
+   */
+  uint8_t size() const
+  {
+    return head - tail;
+  }
+
+  /**
+   * @brief Capacity of the buffer
+   *
+   */
+  static constexpr uint8_t capacity()
+  {
+    return N;
+  }
+
+  /**
+   * @brief Number of elements dropped because the buffer was full (saturates at 255)
+   *
+   */
+  uint8_t get_overflows() const
+  {
+    return overflows;
+  }
+
+private:
+  /**
+   * @brief Compiler barrier, memory accesses are not moved across it
+   *
+   */
+  static void barrier()
+  {
+    __asm__ __volatile__("" ::: "memory");
+  }
+
+  static constexpr uint8_t MASK{ N - 1 }; /**< mask of the index into the buffer */
+
+  T buffer[N];                     /**< the elements */
+  volatile uint8_t head{ 0 };      /**< next element to write, written by the producer only */
+  volatile uint8_t tail{ 0 };      /**< next element to read, written by the consumer only */
+  volatile uint8_t overflows{ 0 }; /**< dropped elements, written by the producer only */
+};
+
+#endif /* UTILS_RINGBUFFER_H */
@@ -0,0 +1,206 @@
+/**
+ * @file utils_rtc.h
+ * @author Frédéric Metrich (frederic.metrich@live.fr)
+ * @brief Software real-time clock, driven by the mains frequency
+ * @version 0.1
+ * @date 2024-12-06
+ *
+ * @copyright Copyright (c) 2024
+ *
+ * @section description Description
+ * The grid operators keep the long-term average of the mains frequency on its nominal value
+ * (the accumulated time error is corrected), so counting mains cycles gives a clock which
+ * doesn't drift over weeks like millis(), which depends on the ceramic resonator of the board.
+ *
+ * The ISR only increments the mains cycle counter (see getMainsCycleCount()). loop() takes the cycles
+ * elapsed since its previous pass, so no cycle is lost however late loop() is.
+ *
+ * The uptime (in seconds) is always available. The time of day and the day of the week are only
+ * known once they've been set with the Serial command "time".
+ */
+
+#ifndef UTILS_RTC_H
+#define UTILS_RTC_H
+
+#include <Arduino.h>
+
+#include "config_system.h"
+#include "processing.h"
+
+/**
+ * @brief Clock driven by the mains cycles
+ * @details All members are static: there's only one clock.
+ *
+ */
+class MainsClock
+{
+public:
+  /**
+   * @brief Take the mains cycles elapsed since the previous call into account
+   * @details To be called on each pass of loop().
+   *
+   */
+  static void proceed()
+  {
+    const uint32_t cycleCount{ getMainsCycleCount() };
+
+    cyclesInSecond += static_cast< uint16_t >(cycleCount - lastCycleCount);
+    lastCycleCount = cycleCount;
+
+    while (cyclesInSecond >= SUPPLY_FREQUENCY)
+    {
+      cyclesInSecond -= SUPPLY_FREQUENCY;
+      tick();
+    }
+  }
+
+  /**
+   * @brief Number of seconds since start-up
+   *
+   */
+  static uint32_t get_uptime()
+  {
+    return uptime;
+  }
+
+  /**
+   * @brief Number of midnights since start-up
+   * @details Before the time of day is set, a "day" is 24 hours of uptime.
+   *
+   */
+  static uint16_t get_dayCount()
+  {
+    return dayCount;
+  }
+
+  /**
+   * @brief Return true once the time of day has been set
+   *
+   */
+  static bool is_set()
+  {
+    return timeIsSet;
+  }
+
+  /**
+   * @brief Number of seconds since midnight
+   *
+   */
+  static uint32_t get_secondsOfDay()
+  {
+    return secondsOfDay;
+  }
+
+  /**
+   * @brief Number of minutes since midnight
+   *
+   */
+  static uint16_t get_minutesOfDay()
+  {
+    return secondsOfDay / SECONDS_PER_MINUTE;
+  }
+
+  /**
+   * @brief Day of the week, 0 for Monday
+   *
+   */
+  static uint8_t get_dayOfWeek()
+  {
+    return dayOfWeek;
+  }
+
+  /**
+   * @brief Set the time of day
+   *
+   * @param day The day of the week, 0 for Monday
+   * @param seconds The number of seconds since midnight
+   * @return true if the values are valid
+   */
+  static bool set(uint8_t day, uint32_t seconds)
+  {
+    if (day >= DAYS_PER_WEEK || seconds >= SECONDS_PER_DAY)
+    {
+      return false;
+    }
+
+    dayOfWeek = day;
+    secondsOfDay = seconds;
+    timeIsSet = true;
+    return true;
+  }
+
+  /**
+   * @brief Print the time of day, e.g. "Mon 14:05:00"
+   *
+   * @param out The output
+   */
+  static void print(Print &out)
+  {
+    if (!timeIsSet)
+    {
+      out.println(F("time not set"));
+      return;
+    }
+
+    static const char dayNames[] PROGMEM = "MonTueWedThuFriSatSun";
+    for (uint8_t i = 0; i < 3; ++i)
+    {
+      out.print(static_cast< char >(pgm_read_byte(dayNames + dayOfWeek * 3 + i)));
+    }
+    out.print(' ');
+
+    const uint16_t minutes{ get_minutesOfDay() };
+    printTwoDigits(out, minutes / MINUTES_PER_HOUR);
+    out.print(':');
+    printTwoDigits(out, minutes % MINUTES_PER_HOUR);
+    out.print(':');
+    printTwoDigits(out, secondsOfDay % SECONDS_PER_MINUTE);
+    out.println();
+  }
+
+private:
+  /**
+   * @brief Advance the clock by one second
+   *
+   */
+  static void tick()
+  {
+    ++uptime;
+
+    if (++secondsOfDay >= SECONDS_PER_DAY)
+    {
+      secondsOfDay = 0;
+      ++dayCount;
+      if (++dayOfWeek >= DAYS_PER_WEEK)
+      {
+        dayOfWeek = 0;
+      }
+    }
+  }
+
+  /**
+   * @brief Print a value with 2 digits
+   *
+   */
+  static void printTwoDigits(Print &out, uint8_t value)
+  {
+    if (value < 10)
+    {
+      out.print('0');
+    }
+    out.print(value);
+  }
+
+  static inline uint32_t lastCycleCount{ 0 }; /**< mains cycle count at the previous call */
+  static inline uint16_t cyclesInSecond{ 0 }; /**< mains cycles of the current second */
+
+  static inline uint32_t uptime{ 0 };       /**< seconds since start-up */
+  static inline uint32_t secondsOfDay{ 0 }; /**< seconds since midnight */
+  static inline uint8_t dayOfWeek{ 0 };     /**< 0 for Monday */
+  static inline uint16_t dayCount{ 0 };     /**< midnights since start-up */
+  static inline bool timeIsSet{ false };    /**< true once the time of day has been set */
+};
+
+inline MainsClock mainsClock; /**< software real-time clock */
+
+#endif /* UTILS_RTC_H */
@@ -0,0 +1,495 @@
+/**
+ * @file utils_schedule.h
+ * @author Frédéric Metrich (frederic.metrich@live.fr)
+ * @brief Schedule of the forced loads (off-peak and time-of-day windows)
+ * @version 0.1
+ * @date 2024-12-07
+ *
+ * @copyright Copyright (c) 2024
+ *
+ * @section description Description
+ * Each window forces one load on some days of the week, either:
+ * - relative to the begin of each off-peak period (dual tariff), like rg_ForceLoad,
+ * - or at a time of day, given by the mains clock (once it has been set).
+ *
+ * The table is sorted at compile time (off-peak windows first, then time-of-day windows,
+ * each by start) and stored in flash. Once per second, only the windows which are starting
+ * are read from flash, and only the active windows are checked for their end.
+ *
+ * The day of a window is the day when it starts. As long as the clock is not set,
+ * only the windows for all days are used.
+ */
+
+#ifndef UTILS_SCHEDULE_H
+#define UTILS_SCHEDULE_H
+
+#include <Arduino.h>
+
+#include "config_system.h"
+#include "utils_dualtariff.h"
+#include "utils_pins.h"
+
+/**
+ * @brief Trigger of a schedule window
+ *
+ */
+enum class ScheduleTriggers : uint8_t
+{
+  OFF_PEAK,    /**< relative to the begin or the end of the off-peak period */
+  TIME_OF_DAY, /**< at a time of day */
+};
+
+inline constexpr uint8_t MONDAY{ 1 << 0 };
+inline constexpr uint8_t TUESDAY{ 1 << 1 };
+inline constexpr uint8_t WEDNESDAY{ 1 << 2 };
+inline constexpr uint8_t THURSDAY{ 1 << 3 };
+inline constexpr uint8_t FRIDAY{ 1 << 4 };
+inline constexpr uint8_t SATURDAY{ 1 << 5 };
+inline constexpr uint8_t SUNDAY{ 1 << 6 };
+inline constexpr uint8_t WEEK_DAYS{ MONDAY | TUESDAY | WEDNESDAY | THURSDAY | FRIDAY };
+inline constexpr uint8_t WEEK_END{ SATURDAY | SUNDAY };
+inline constexpr uint8_t ALL_DAYS{ WEEK_DAYS | WEEK_END };
+
+inline constexpr uint16_t UNTIL_END_OF_OFF_PEAK{ UINT16_MAX }; /**< duration of an off-peak window lasting till the end of the period */
+
+/**
+ * @brief A force window, as written in the configuration
+ *
+ */
+struct ScheduleWindow
+{
+  uint8_t load{ 0 };                                      /**< the load (0-based) */
+  uint8_t days{ ALL_DAYS };                               /**< the days of the week (MONDAY, ..., WEEK_END, ALL_DAYS) */
+  ScheduleTriggers trigger{ ScheduleTriggers::OFF_PEAK }; /**< what the start refers to */
+  int16_t start{ 0 };                                     /**< in minutes, after midnight, or after the begin (>= 0) / before the end (< 0) of the off-peak period */
+  uint16_t duration{ 0 };                                 /**< in minutes, or UNTIL_END_OF_OFF_PEAK */
+};
+
+/**
+ * @brief Window relative to the off-peak period
+ *
+ * @param load The load (0-based)
+ * @param force The offset and the duration, with the same rules as rg_ForceLoad (hours or minutes)
+ * @param days The days of the week
+ * @return constexpr ScheduleWindow The window
+ */
+constexpr ScheduleWindow offPeakWindow(uint8_t load, const pairForceLoad &force, uint8_t days = ALL_DAYS)
+{
+  const int16_t offset{ force.getStartOffset() };
+  const uint16_t duration{ force.getDuration() };
+
+  return { load, days, ScheduleTriggers::OFF_PEAK,
+           static_cast< int16_t >((offset > 24 || offset < -24) ? offset : offset * MINUTES_PER_HOUR),
+           static_cast< uint16_t >(duration > 24 ? duration : duration * MINUTES_PER_HOUR) };
+}
+
+/**
+ * @brief Window at a time of day, it may go on after midnight
+ *
+ * @param load The load (0-based)
+ * @param hour The start hour
+ * @param minute The start minute
+ * @param durationInMinutes The duration in minutes
+ * @param days The days of the week
+ * @return constexpr ScheduleWindow The window
+ */
+constexpr ScheduleWindow timeWindow(uint8_t load, uint8_t hour, uint8_t minute, uint16_t durationInMinutes, uint8_t days = ALL_DAYS)
+{
+  return { load, days, ScheduleTriggers::TIME_OF_DAY, static_cast< int16_t >(hour * MINUTES_PER_HOUR + minute), durationInMinutes };
+}
+
+/**
+ * @brief A force window, as stored in the table
+ *
+ */
+struct ScheduleEntry
+{
+  uint8_t load{ 0 };   /**< the load (0-based) */
+  uint8_t days{ 0 };   /**< the days of the week */
+  uint16_t start{ 0 }; /**< in minutes, after midnight or after the begin of the off-peak period */
+  uint16_t end{ 0 };   /**< in minutes, same reference (may exceed one day), or UNTIL_END_OF_OFF_PEAK */
+};
+
+/**
+ * @brief Sorted table of force windows, to be computed at compile time and stored in flash
+ * @details The runtime state is held in static members: there's only one schedule.
+ *
+ * @tparam N Number of windows
+ *
+ * @ingroup DualTariff
+ */
+template< uint8_t N > class ScheduleTable
+{
+  static_assert(N <= 16, "******** Too many schedule windows ! ********");
+
+public:
+  /**
+   * @brief Resolve and sort the windows
+   *
+   * @param windows The windows
+   * @param offPeakDuration The duration of the off-peak period in hours, for the offsets from its end
+   */
+  constexpr ScheduleTable(const ScheduleWindow (&windows)[N], uint8_t offPeakDuration)
+  {
+    for (uint8_t i = 0; i < N; ++i)
+    {
+      const auto &window{ windows[i] };
+      const bool offPeak{ window.trigger == ScheduleTriggers::OFF_PEAK };
+      const int16_t start{ static_cast< int16_t >(window.start >= 0 || !offPeak ? window.start : offPeakDuration * MINUTES_PER_HOUR + window.start) };
+
+      if (start < 0 || window.days == 0 || window.days > ALL_DAYS
+          || (!offPeak && (start >= static_cast< int16_t >(MINUTES_PER_DAY) || window.duration > MINUTES_PER_DAY)))
+      {
+        valid = false;
+        continue;
+      }
+
+      ScheduleEntry entry{ window.load, window.days, static_cast< uint16_t >(start), UNTIL_END_OF_OFF_PEAK };
+      if (!offPeak || window.duration != UNTIL_END_OF_OFF_PEAK)
+      {
+        const uint32_t end{ static_cast< uint32_t >(start) + window.duration };
+        entry.end = end < UNTIL_END_OF_OFF_PEAK ? end : UNTIL_END_OF_OFF_PEAK - 1;
+      }
+
+      if (offPeak)
+      {
+        ++offPeakCount;
+      }
+      insert(entry, offPeak);
+    }
+  }
+
+  /**
+   * @brief Check the settings at compile time
+   *
+   * @param noOfLoads The number of loads
+   * @return true if all windows are valid
+   */
+  constexpr bool check_settings(uint8_t noOfLoads) const
+  {
+    if (!valid || noOfLoads > 8)
+    {
+      return false;
+    }
+    for (uint8_t i = 0; i < size; ++i)
+    {
+      if (entries[i].load >= noOfLoads)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief Update the active windows, to be called once per second
+   *
+   * @tparam Clock The clock type (MainsClock)
+   * @param clock The clock
+   * @param offPeak true during the off-peak period
+   * @return uint8_t The forced loads, bit i for load i
+   */
+  template< typename Clock > uint8_t proceed(const Clock &clock, bool offPeak) const
+  {
+    const uint32_t now{ clock.get_uptime() };
+
+    expire(now);
+    proceedOffPeak(clock, now, offPeak);
+
+    if (clock.is_set())
+    {
+      proceedTimeOfDay(clock, now);
+    }
+
+    uint8_t loads{ 0 };
+    for (uint8_t i = 0; i < activeCount; ++i)
+    {
+      loads |= bit(activeLoad[i]);
+    }
+    return loads;
+  }
+
+  /**
+   * @brief Print the windows
+   *
+   * @param out The output
+   */
+  void printConfiguration(Print &out) const
+  {
+    static const char dayLetters[] PROGMEM = "MTWTFSS";
+
+    const uint8_t noOfOffPeak{ pgm_read_byte(&offPeakCount) };
+    const uint8_t count{ pgm_read_byte(&size) };
+
+    for (uint8_t i = 0; i < count; ++i)
+    {
+      const auto entry{ readEntry(i) };
+
+      out.print(F("\tLoad #"));
+      out.print(entry.load + 1);
+      out.print(i < noOfOffPeak ? F(", off-peak + ") : F(", time of day "));
+      out.print(entry.start);
+      out.print(F(" to "));
+      if (entry.end == UNTIL_END_OF_OFF_PEAK)
+      {
+        out.print(F("end"));
+      }
+      else
+      {
+        out.print(entry.end);
+      }
+      out.print(F(" min, "));
+      for (uint8_t day = 0; day < 7; ++day)
+      {
+        out.print(bit_read(entry.days, day) ? static_cast< char >(pgm_read_byte(dayLetters + day)) : '-');
+      }
+      out.println();
+    }
+  }
+
+private:
+  /**
+   * @brief Insert an entry at its place (insertion sort)
+   *
+   */
+  constexpr void insert(const ScheduleEntry &entry, bool offPeak)
+  {
+    // off-peak entries are kept in [0, offPeakCount), time-of-day entries after
+    uint8_t first{ static_cast< uint8_t >(offPeak ? 0 : offPeakCount) };
+    uint8_t pos{ static_cast< uint8_t >(offPeak ? offPeakCount - 1 : size) };
+
+    // make room at the end of the off-peak entries
+    for (uint8_t i = size; i > pos; --i)
+    {
+      entries[i] = entries[i - 1];
+    }
+    while (pos > first && entries[pos - 1].start > entry.start)
+    {
+      entries[pos] = entries[pos - 1];
+      --pos;
+    }
+    entries[pos] = entry;
+    ++size;
+  }
+
+  /**
+   * @brief Read an entry from flash
+   *
+   */
+  ScheduleEntry readEntry(uint8_t idx) const
+  {
+    ScheduleEntry entry;
+    memcpy_P(&entry, entries + idx, sizeof(entry));
+    return entry;
+  }
+
+  /**
+   * @brief Return true if a window is used on this day
+   *
+   */
+  template< typename Clock > static bool isDue(const Clock &clock, uint8_t days, uint8_t day)
+  {
+    return days == ALL_DAYS || (clock.is_set() && bit_read(days, day));
+  }
+
+  /**
+   * @brief Start the off-peak windows which are due
+   *
+   */
+  template< typename Clock > void proceedOffPeak(const Clock &clock, uint32_t now, bool offPeak) const
+  {
+    const uint8_t noOfOffPeak{ pgm_read_byte(&offPeakCount) };
+
+    if (!offPeak)
+    {
+      if (inOffPeak)
+      {
+        inOffPeak = false;
+        release(0, noOfOffPeak);
+      }
+      return;
+    }
+
+    if (!inOffPeak)
+    {
+      inOffPeak = true;
+      offPeakStart = now;
+      nextOffPeak = 0;
+    }
+
+    const uint32_t elapsed{ (now - offPeakStart) / SECONDS_PER_MINUTE };
+
+    while (nextOffPeak < noOfOffPeak)
+    {
+      const auto entry{ readEntry(nextOffPeak) };
+      if (entry.start > elapsed)
+      {
+        break;
+      }
+      if (entry.end > elapsed && isDue(clock, entry.days, clock.get_dayOfWeek()))
+      {
+        activate(nextOffPeak, entry.load, entry.end == UNTIL_END_OF_OFF_PEAK ? UINT32_MAX : offPeakStart + entry.end * static_cast< uint32_t >(SECONDS_PER_MINUTE));
+      }
+      ++nextOffPeak;
+    }
+  }
+
+  /**
+   * @brief Start the time-of-day windows which are due
+   * @details When the clock has been set (or at the first call), the windows already running are restored.
+   *
+   */
+  template< typename Clock > void proceedTimeOfDay(const Clock &clock, uint32_t now) const
+  {
+    const uint8_t noOfOffPeak{ pgm_read_byte(&offPeakCount) };
+    const uint8_t count{ pgm_read_byte(&size) };
+    const uint16_t minutes{ clock.get_minutesOfDay() };
+    const uint32_t midnight{ now - clock.get_secondsOfDay() };
+
+    if (midnight != lastMidnight)
+    {
+      nextTime = noOfOffPeak;
+
+      if (!timeSynced || midnight != lastMidnight + SECONDS_PER_DAY)
+      {
+        // the clock has been set: restart from scratch, including the windows of yesterday still running
+        const uint8_t yesterday{ static_cast< uint8_t >((clock.get_dayOfWeek() + DAYS_PER_WEEK - 1) % DAYS_PER_WEEK) };
+
+        release(noOfOffPeak, count);
+        for (uint8_t i = noOfOffPeak; i < count; ++i)
+        {
+          const auto entry{ readEntry(i) };
+          if (entry.end > MINUTES_PER_DAY + minutes && isDue(clock, entry.days, yesterday))
+          {
+            activate(i, entry.load, midnight - SECONDS_PER_DAY + entry.end * static_cast< uint32_t >(SECONDS_PER_MINUTE));
+          }
+        }
+      }
+      lastMidnight = midnight;
+      timeSynced = true;
+    }
+
+    while (nextTime < count)
+    {
+      const auto entry{ readEntry(nextTime) };
+      if (entry.start > minutes)
+      {
+        break;
+      }
+      if (entry.end > minutes && isDue(clock, entry.days, clock.get_dayOfWeek()))
+      {
+        activate(nextTime, entry.load, midnight + entry.end * static_cast< uint32_t >(SECONDS_PER_MINUTE));
+      }
+      ++nextTime;
+    }
+  }
+
+  /**
+   * @brief Add a window to the active ones
+   *
+   */
+  static void activate(uint8_t idx, uint8_t load, uint32_t end)
+  {
+    if (activeCount < N)
+    {
+      activeIndex[activeCount] = idx;
+      activeLoad[activeCount] = load;
+      activeEnd[activeCount] = end;
+      ++activeCount;
+    }
+  }
+
+  /**
+   * @brief Remove an active window, the last one takes its place
+   *
+   */
+  static void remove(uint8_t i)
+  {
+    --activeCount;
+    activeIndex[i] = activeIndex[activeCount];
+    activeLoad[i] = activeLoad[activeCount];
+    activeEnd[i] = activeEnd[activeCount];
+  }
+
+  /**
+   * @brief Remove the active windows which are over
+   *
+   */
+  static void expire(uint32_t now)
+  {
+    uint8_t i{ activeCount };
+    while (i)
+    {
+      --i;
+      if (now >= activeEnd[i])
+      {
+        remove(i);
+      }
+    }
+  }
+
+  /**
+   * @brief Remove the active windows of the given range of the table
+   *
+   */
+  static void release(uint8_t first, uint8_t last)
+  {
+    uint8_t i{ activeCount };
+    while (i)
+    {
+      --i;
+      if (activeIndex[i] >= first && activeIndex[i] < last)
+      {
+        remove(i);
+      }
+    }
+  }
+
+  ScheduleEntry entries[N]{}; /**< off-peak entries first, then time-of-day entries, each sorted by start */
+  uint8_t size{ 0 };          /**< number of valid entries */
+  uint8_t offPeakCount{ 0 };  /**< number of off-peak entries */
+  bool valid{ true };         /**< false if a window is invalid */
+
+  static inline uint8_t activeIndex[N]{}; /**< entries of the active windows */
+  static inline uint8_t activeLoad[N]{};  /**< loads of the active windows */
+  static inline uint32_t activeEnd[N]{};  /**< uptime (in seconds) at which each active window ends */
+  static inline uint8_t activeCount{ 0 }; /**< number of active windows */
+
+  static inline bool inOffPeak{ false };     /**< state of the off-peak period at the previous call */
+  static inline uint32_t offPeakStart{ 0 };  /**< uptime at the begin of the current off-peak period */
+  static inline uint8_t nextOffPeak{ 0 };    /**< next off-peak entry to be started */
+  static inline uint8_t nextTime{ 0 };       /**< next time-of-day entry to be started */
+  static inline uint32_t lastMidnight{ 0 };  /**< uptime at the last midnight */
+  static inline bool timeSynced{ false };    /**< true once the time-of-day entries follow the clock */
+};
+
+/**
+ * @brief Build the schedule from rg_ForceLoad and additional windows
+ * @details Window i of rg_ForceLoad forces load i every day.
+ *
+ * @tparam OffPeakDuration The duration of the off-peak period in hours
+ * @tparam L Number of loads
+ * @tparam W Additional windows
+ * @param forceLoad The off-peak window of each load (rg_ForceLoad)
+ * @param windows Additional windows (offPeakWindow, timeWindow)
+ * @return constexpr auto The sorted table
+ *
+ * @ingroup DualTariff
+ */
+template< uint8_t OffPeakDuration, uint8_t L, typename... W > constexpr auto makeSchedule(const pairForceLoad (&forceLoad)[L], W... windows)
+{
+  constexpr uint8_t N{ L + sizeof...(W) };
+  ScheduleWindow all[N]{};
+
+  for (uint8_t i = 0; i < L; ++i)
+  {
+    all[i] = offPeakWindow(i, forceLoad[i]);
+  }
+
+  uint8_t i{ L };
+  ((all[i++] = windows), ...);
+
+  return ScheduleTable< N >(all, OffPeakDuration);
+}
+
+#endif /* UTILS_SCHEDULE_H */
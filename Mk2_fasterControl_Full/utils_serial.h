@@ -0,0 +1,451 @@
+/**
+ * @file utils_serial.h
+ * @author Frédéric Metrich (frederic.metrich@live.fr)
+ * @brief Non-blocking transmit queue for the Serial output
+ * @version 0.1
+ * @date 2024-11-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ * @section description Description
+ * With HardwareSerial, 'print' blocks as soon as the 64-byte TX buffer is full.
+ * At 9600 baud, a full datalog line stalls loop() for ~100 ms, long enough to make the
+ * 7-segments display flicker.
+ *
+ * Instead of printing directly, records are queued here and serialised lazily,
+ * only as many bytes as the UART buffer can accept without blocking.
+ *
+ * Two kinds of records are supported:
+ *  - debug lines: a flash-string pointer (2 bytes)
+ *  - telemetry: a snapshot struct, rendered field by field when it reaches the head of the queue
+ *
+ * When the queue is full, the oldest debug line is dropped first. Telemetry is only dropped
+ * when there is no debug line left to make room.
+ */
+
+#ifndef UTILS_SERIAL_H
+#define UTILS_SERIAL_H
+
+#include <Arduino.h>
+
+#include "config_system.h"
+#include "debug.h"
+#include "utils_pins.h"
+
+inline constexpr uint8_t TX_QUEUE_SIZE{ 8 };     /**< number of records in the queue, must be a power of 2 */
+inline constexpr uint8_t TX_TELEMETRY_SLOTS{ 2 }; /**< number of telemetry snapshots which can be queued */
+inline constexpr uint8_t TX_CHUNK_SIZE{ 24 };    /**< max length of a rendered telemetry field */
+
+inline constexpr uint8_t TX_RESERVED_ROOM{ STREAM_PERIOD_IN_MAINS_CYCLES ? 8 : 0 }; /**< room kept free in the UART buffer for the streaming datalog */
+
+static_assert((TX_QUEUE_SIZE & (TX_QUEUE_SIZE - 1)) == 0, "TX_QUEUE_SIZE must be a power of 2 !");
+static_assert(TX_TELEMETRY_SLOTS < TX_QUEUE_SIZE, "TX_TELEMETRY_SLOTS must be smaller than TX_QUEUE_SIZE !");
+
+/** Kind of record */
+enum class TxRecordType : uint8_t
+{
+  DEBUG_LINE, /**< flash-string, terminated with CR/LF */
+  TELEMETRY   /**< telemetry snapshot */
+};
+
+/**
+ * @brief Small Print-sink used to render one telemetry field
+ * @details The standard 'print' functions are reused, so the output format is the same
+ *          as with direct printing. Characters beyond the capacity are discarded.
+ *
+ */
+class TxChunk : public Print
+{
+public:
+  size_t write(uint8_t c) override
+  {
+    if (len >= TX_CHUNK_SIZE)
+    {
+      return 0;
+    }
+    buf[len++] = c;
+    return 1;
+  }
+
+  using Print::write;
+
+  /**
+   * @brief Reset the chunk before rendering a new field
+   *
+   */
+  void clear()
+  {
+    len = 0;
+    sent = 0;
+  }
+
+  /**
+   * @brief Return true if some characters still need to be sent
+   *
+   */
+  bool pending() const
+  {
+    return sent < len;
+  }
+
+  /**
+   * @brief Send as many characters as the UART accepts without blocking
+   *
+   * @return true if the whole chunk has been sent
+   */
+  bool flush_to(HardwareSerial &port)
+  {
+    auto room{ port.availableForWrite() - TX_RESERVED_ROOM };
+    while (sent < len && room > 0)
+    {
+      port.write(buf[sent++]);
+      --room;
+    }
+    return !pending();
+  }
+
+private:
+  char buf[TX_CHUNK_SIZE];
+  uint8_t len{ 0 };
+  uint8_t sent{ 0 };
+};
+
+/**
+ * @brief Record queue, independent of the telemetry type
+ * @details All members are static so that debug lines can be queued from anywhere,
+ *          even from code compiled before the telemetry type is known.
+ *
+ */
+class SerialTxQueueBase
+{
+public:
+  /**
+   * @brief Queue a debug line
+   * @details If the queue is full, the line is dropped (older records are kept).
+   *
+   * @param msg The flash-string to be printed
+   */
+  static void push_debug(const __FlashStringHelper *msg)
+  {
+    if (count >= TX_QUEUE_SIZE)
+    {
+      ++droppedDebug;
+      return;
+    }
+
+    auto &rec{ records[(head + count) & TX_QUEUE_MASK] };
+    rec.type = TxRecordType::DEBUG_LINE;
+    rec.msg = msg;
+
+    push_commit();
+  }
+
+  /**
+   * @brief Number of records currently queued
+   *
+   */
+  static uint8_t size()
+  {
+    return count;
+  }
+
+  /**
+   * @brief Return true while a line is partially sent
+   * @details Other output must wait, otherwise it would end up in the middle of that line.
+   *
+   */
+  static bool lineInProgress()
+  {
+    return headInProgress;
+  }
+
+  /**
+   * @brief Highest number of queued records since start-up
+   *
+   */
+  static uint8_t get_highWatermark()
+  {
+    return highWatermark;
+  }
+
+  /**
+   * @brief Number of dropped debug lines since start-up
+   *
+   */
+  static uint16_t get_droppedDebug()
+  {
+    return droppedDebug;
+  }
+
+  /**
+   * @brief Number of dropped telemetry records since start-up
+   *
+   */
+  static uint16_t get_droppedTelemetry()
+  {
+    return droppedTelemetry;
+  }
+
+protected:
+  static constexpr uint8_t TX_QUEUE_MASK{ TX_QUEUE_SIZE - 1 };
+
+  /** One entry of the queue */
+  struct TxRecord
+  {
+    TxRecordType type;
+    union
+    {
+      const __FlashStringHelper *msg; /**< for debug lines */
+      uint8_t slot;                   /**< telemetry slot for telemetry records */
+    };
+  };
+
+  /**
+   * @brief Account for a record written at the tail
+   *
+   */
+  static void push_commit()
+  {
+    ++count;
+    if (count > highWatermark)
+    {
+      highWatermark = count;
+    }
+  }
+
+  /**
+   * @brief Remove the record at the given offset from the head
+   * @details Older records are shifted by one position, the order is kept.
+   *
+   * @param offset Offset from the head (0 is the oldest record)
+   */
+  static void remove_at(uint8_t offset)
+  {
+    while (offset)
+    {
+      records[(head + offset) & TX_QUEUE_MASK] = records[(head + offset - 1) & TX_QUEUE_MASK];
+      --offset;
+    }
+    head = (head + 1) & TX_QUEUE_MASK;
+    --count;
+  }
+
+  /**
+   * @brief Find the oldest record of the given type which is not being sent
+   *
+   * @param type The type of record
+   * @return uint8_t The offset from the head, TX_QUEUE_SIZE if none
+   */
+  static uint8_t find_oldest(TxRecordType type)
+  {
+    for (uint8_t offset = headInProgress ? 1 : 0; offset < count; ++offset)
+    {
+      if (records[(head + offset) & TX_QUEUE_MASK].type == type)
+      {
+        return offset;
+      }
+    }
+    return TX_QUEUE_SIZE;
+  }
+
+  static inline TxRecord records[TX_QUEUE_SIZE]; /**< circular buffer of records */
+  static inline uint8_t head{ 0 };               /**< index of the oldest record */
+  static inline uint8_t count{ 0 };              /**< number of queued records */
+  static inline bool headInProgress{ false };    /**< the oldest record is partially sent */
+  static inline uint8_t progress{ 0 };           /**< character (debug) or field (telemetry) index of the head record */
+
+  static inline uint8_t highWatermark{ 0 };     /**< highest number of queued records */
+  static inline uint16_t droppedDebug{ 0 };     /**< number of dropped debug lines */
+  static inline uint16_t droppedTelemetry{ 0 }; /**< number of dropped telemetry records */
+};
+
+/**
+ * @brief Non-blocking transmit queue
+ *
+ * @tparam T Telemetry type. It must provide 'bool printField(uint8_t idx, Print &out) const'
+ *           which prints the field #idx and returns false once all fields have been printed.
+ */
+template< typename T >
+class SerialTxQueue : public SerialTxQueueBase
+{
+public:
+  /**
+   * @brief Queue a telemetry record
+   * @details The oldest debug line is dropped if the queue is full.
+   *          If there's none, the oldest telemetry is dropped instead.
+   *
+   * @param rec The telemetry record
+   */
+  static void push_telemetry(const T &rec)
+  {
+    if (count >= TX_QUEUE_SIZE && !make_room())
+    {
+      ++droppedTelemetry;
+      return;
+    }
+
+    uint8_t slot{ find_free_slot() };
+    if (slot >= TX_TELEMETRY_SLOTS)
+    {
+      // all slots are in use, recycle the oldest telemetry which is not being sent
+      const auto offset{ find_oldest(TxRecordType::TELEMETRY) };
+      if (offset >= TX_QUEUE_SIZE)
+      {
+        ++droppedTelemetry;
+        return;
+      }
+      slot = records[(head + offset) & TX_QUEUE_MASK].slot;
+      remove_at(offset);
+      ++droppedTelemetry;
+    }
+
+    telemetry[slot] = rec;
+    bit_set(usedSlots, slot);
+
+    auto &entry{ records[(head + count) & TX_QUEUE_MASK] };
+    entry.type = TxRecordType::TELEMETRY;
+    entry.slot = slot;
+
+    push_commit();
+  }
+
+  /**
+   * @brief Send queued data as long as the UART accepts it without blocking
+   * @details To be called on each pass of loop().
+   *
+   */
+  static void pump()
+  {
+    while (count)
+    {
+      if (chunk.pending() && !chunk.flush_to(Serial))
+      {
+        return;  // UART buffer is full
+      }
+
+      const auto &rec{ records[head] };
+
+      if (rec.type == TxRecordType::DEBUG_LINE)
+      {
+        if (!pump_debug(rec.msg))
+        {
+          return;
+        }
+        pop();
+        continue;
+      }
+
+      chunk.clear();
+      if (!telemetry[rec.slot].printField(progress, chunk))
+      {
+        bit_clear(usedSlots, rec.slot);
+        pop();
+        continue;
+      }
+      ++progress;
+      headInProgress = true;
+    }
+  }
+
+private:
+  /**
+   * @brief Send the remaining part of a debug line
+   *
+   * @param msg The flash-string
+   * @return true if the whole line (including CR/LF) has been sent
+   */
+  static bool pump_debug(const __FlashStringHelper *msg)
+  {
+    const auto *p{ reinterpret_cast< const char * >(msg) + progress };
+    auto room{ Serial.availableForWrite() - TX_RESERVED_ROOM };
+
+    while (room > 2)
+    {
+      const char c{ static_cast< char >(pgm_read_byte(p++)) };
+      if (!c)
+      {
+        Serial.write('\r');
+        Serial.write('\n');
+        return true;
+      }
+      Serial.write(c);
+      ++progress;
+      --room;
+      headInProgress = true;
+    }
+    return false;
+  }
+
+  /**
+   * @brief Remove the head record once it has been fully sent
+   *
+   */
+  static void pop()
+  {
+    head = (head + 1) & TX_QUEUE_MASK;
+    --count;
+    progress = 0;
+    headInProgress = false;
+  }
+
+  /**
+   * @brief Free one entry, dropping debug lines before telemetry
+   *
+   * @return true if an entry has been freed
+   */
+  static bool make_room()
+  {
+    auto offset{ find_oldest(TxRecordType::DEBUG_LINE) };
+    if (offset < TX_QUEUE_SIZE)
+    {
+      remove_at(offset);
+      ++droppedDebug;
+      return true;
+    }
+
+    offset = find_oldest(TxRecordType::TELEMETRY);
+    if (offset < TX_QUEUE_SIZE)
+    {
+      bit_clear(usedSlots, records[(head + offset) & TX_QUEUE_MASK].slot);
+      remove_at(offset);
+      ++droppedTelemetry;
+      return true;
+    }
+
+    return false;
+  }
+
+  /**
+   * @brief Find a free telemetry slot
+   *
+   * @return uint8_t The slot index, TX_TELEMETRY_SLOTS if none
+   */
+  static uint8_t find_free_slot()
+  {
+    for (uint8_t slot = 0; slot < TX_TELEMETRY_SLOTS; ++slot)
+    {
+      if (!bit_read(usedSlots, slot))
+      {
+        return slot;
+      }
+    }
+    return TX_TELEMETRY_SLOTS;
+  }
+
+  static inline T telemetry[TX_TELEMETRY_SLOTS]; /**< telemetry snapshots */
+  static inline uint8_t usedSlots{ 0 };          /**< bit field of used telemetry slots */
+  static inline TxChunk chunk;                   /**< rendering buffer for the current telemetry field */
+};
+
+/**
+ * @brief Queue a debug line instead of printing it immediately
+ * @note With EmonESP, the debug port is a SoftwareSerial so the line is printed directly.
+ *
+ */
+#if defined(ENABLE_DEBUG) && !defined(EMONESP)
+#define DBUGLN_Q(msg) SerialTxQueueBase::push_debug(msg)
+#else
+#define DBUGLN_Q(msg) DBUGLN(msg)
+#endif
+
+#endif /* UTILS_SERIAL_H */
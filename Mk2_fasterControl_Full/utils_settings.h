@@ -0,0 +1,109 @@
+/**
+ * @file utils_settings.h
+ * @author Frédéric Metrich (frederic.metrich@live.fr)
+ * @brief Runtime settings, stored in EEPROM
+ * @version 0.1
+ * @date 2024-12-08
+ *
+ * @copyright Copyright (c) 2024
+ *
+ * @section description Description
+ * The calibration and the main thresholds can be changed without recompiling.
+ * The values of calibration.h and config_system.h are the defaults, used as long as
+ * nothing valid has been saved.
+ *
+ * The settings are loaded once at start-up into a RAM struct. The values used by the ISR
+ * are derived from it in applySettings(), so the ISR doesn't do more work than with
+ * compile-time constants.
+ *
+ * In EEPROM, the saves rotate over SETTINGS_SLOTS wear-levelled slots (see utils_eeprom.h).
+ */
+
+#ifndef UTILS_SETTINGS_H
+#define UTILS_SETTINGS_H
+
+#include <Arduino.h>
+
+#include "calibration.h"
+#include "config_system.h"
+#include "utils_eeprom.h"
+
+inline constexpr uint16_t SETTINGS_EEPROM_ADDRESS{ 128 }; /**< location of the settings slots in EEPROM (after the ROM table of the sensors) */
+inline constexpr uint8_t SETTINGS_VERSION{ 1 };           /**< layout version of the settings */
+inline constexpr uint8_t SETTINGS_SLOTS{ 4 };             /**< number of slots the saves rotate over */
+
+/**
+ * @brief Settings which can be changed at runtime
+ *
+ */
+struct Settings
+{
+  float gridPowerCal{ powerCal_grid };                  /**< powerCal for CT1 */
+  float divertedPowerCal{ powerCal_diverted };          /**< powerCal for CT2 */
+  float voltageCal{ f_voltageCal };                     /**< voltage calibration */
+  int16_t requiredExport_W{ REQUIRED_EXPORT_IN_WATTS }; /**< required export, negative to simulate a PV generator */
+  uint16_t workingZone_J{ WORKING_ZONE_IN_JOULES };     /**< size of the energy bucket in Joules */
+  uint8_t antiCreepLimit_J{ ANTI_CREEP_LIMIT };         /**< anti-creep limit in Joules per mains cycle */
+};
+
+using SettingsSlots = EepromSlots< Settings, SETTINGS_EEPROM_ADDRESS, SETTINGS_SLOTS, SETTINGS_VERSION >; /**< EEPROM slots of the settings */
+
+inline constexpr uint16_t SETTINGS_EEPROM_END{ SettingsSlots::END }; /**< first EEPROM address after the slots */
+
+inline Settings settings; /**< runtime settings, loaded from EEPROM at start-up */
+
+/**
+ * @brief Load/save the runtime settings from/to EEPROM
+ * @details All members are static: there's only one set of settings.
+ *
+ */
+class SettingsStore
+{
+public:
+  /**
+   * @brief Load the latest valid slot into 'settings'
+   *
+   * @return true if valid settings have been found, false if the defaults are used
+   */
+  static bool load()
+  {
+    fromEEPROM = SettingsSlots::load(settings);
+    return fromEEPROM;
+  }
+
+  /**
+   * @brief Save 'settings' into the next slot (only the changed bytes are written)
+   *
+   */
+  static void save()
+  {
+    SettingsSlots::save(settings);
+    fromEEPROM = true;
+  }
+
+  /**
+   * @brief Restore the defaults and save them
+   *
+   */
+  static void reset()
+  {
+    settings = Settings{};
+    save();
+  }
+
+  /**
+   * @brief Return true if the settings in use come from EEPROM
+   *
+   */
+  static bool is_fromEEPROM()
+  {
+    return fromEEPROM;
+  }
+
+private:
+  static inline bool fromEEPROM{ false }; /**< true if the settings in use come from EEPROM */
+};
+
+inline SettingsStore settingsStore; /**< EEPROM store of the settings */
+
+#endif /* UTILS_SETTINGS_H */
@@ -0,0 +1,126 @@
+/**
+ * @file utils_stream.h
+ * @author Frédéric Metrich (frederic.metrich@live.fr)
+ * @brief Sub-second streaming datalog, as compact binary records
+ * @version 0.1
+ * @date 2024-11-27
+ *
+ * @copyright Copyright (c) 2024
+ *
+ * @section description Description
+ * When STREAM_PERIOD_IN_MAINS_CYCLES is not 0, the average power over that many mains cycles
+ * is sent to the Serial output as an 8-byte binary record. The datalog summary is still
+ * printed every DATALOG_PERIOD_IN_SECONDS, on the same output.
+ *
+ * Record layout (little-endian):
+ * | byte | content                                                     |
+ * |------|-------------------------------------------------------------|
+ * | 0    | sync byte 0xA5 (never part of the text output)              |
+ * | 1    | sequence number, a gap means that records have been dropped |
+ * | 2-3  | grid power in W (int16_t, import = +ve)                     |
+ * | 4-5  | diverted power in W (int16_t)                               |
+ * | 6    | state of the loads (bit i is set when load #i is ON)        |
+ * | 7    | checksum, the sum of bytes 1 to 7 is 0 (modulo 256)         |
+ *
+ * A record is always written in one go, and only between two text lines: while the text output
+ * is in the middle of a line, the record waits. If the next streaming period ends in the meantime,
+ * the waiting record is replaced by the newer one, which shows as a gap in the sequence numbers.
+ * TX_RESERVED_ROOM bytes are kept free in the UART buffer by the text output for that purpose.
+ */
+
+#ifndef UTILS_STREAM_H
+#define UTILS_STREAM_H
+
+#include <Arduino.h>
+
+#include "calibration.h"
+#include "config.h"
+#include "processing.h"
+#include "utils_serial.h"
+#include "utils_settings.h"
+
+inline constexpr uint8_t STREAM_SYNC_BYTE{ 0xA5 };          /**< first byte of each record */
+inline constexpr uint16_t STREAM_SUMMARY_MAX_LENGTH{ 200 }; /**< max number of bytes of text output per datalog period */
+
+/** Streaming record */
+struct __attribute__((packed)) StreamRecord
+{
+  uint8_t sync;          /**< STREAM_SYNC_BYTE */
+  uint8_t seq;           /**< sequence number */
+  int16_t powerGrid;     /**< grid power (W), import = +ve */
+  int16_t powerDiverted; /**< diverted power (W) */
+  uint8_t loadsON;       /**< state of the loads */
+  uint8_t checksum;      /**< makes the sum of bytes 1 to 7 equal to 0 */
+};
+
+static_assert(sizeof(StreamRecord) <= TX_RESERVED_ROOM || STREAM_PERIOD_IN_MAINS_CYCLES == 0, "******** TX_RESERVED_ROOM is too small for the streaming record ! ********");
+
+/** bytes per second needed by the streaming records and the datalog summary */
+inline constexpr uint32_t STREAM_BYTES_PER_SECOND{ STREAM_PERIOD_IN_MAINS_CYCLES ? sizeof(StreamRecord) * SUPPLY_FREQUENCY / STREAM_PERIOD_IN_MAINS_CYCLES + STREAM_SUMMARY_MAX_LENGTH / DATALOG_PERIOD_IN_SECONDS : 0 };
+
+// 10 bits per byte on the wire, and keep half of the bandwidth as margin
+static_assert(STREAM_BYTES_PER_SECOND * 10 * 2 <= SERIAL_BAUD_RATE, "******** SERIAL_BAUD_RATE is too low for the streaming datalog ! ********");
+static_assert(!STREAM_PERIOD_IN_MAINS_CYCLES | !EMONESP_CONTROL, "******** The streaming datalog uses the Serial output, it cannot be used with EmonESP ! ********");
+
+/**
+ * @brief Sends the streaming records
+ *
+ */
+class StreamDatalog
+{
+public:
+  /**
+   * @brief Send a record if one is available
+   * @details To be called on each pass of loop(), before the text output.
+   *          The record waits while a text line is partially sent.
+   *          If the UART buffer is full, the record is dropped, it never blocks.
+   *
+   */
+  static void proceed()
+  {
+    if (!b_streamEventPending || SerialTxQueueBase::lineInProgress())
+    {
+      return;
+    }
+    b_streamEventPending = false;
+
+    StreamRecord rec;
+    rec.sync = STREAM_SYNC_BYTE;
+    rec.seq = copyOf_streamSeq;
+    rec.powerGrid = -copyOf_sumP_grid_overStreamPeriod / copyOf_sampleSetsDuringThisStreamPeriod * settings.gridPowerCal;
+    rec.powerDiverted = copyOf_sumP_diverted_overStreamPeriod / copyOf_sampleSetsDuringThisStreamPeriod * settings.divertedPowerCal;
+    rec.loadsON = copyOf_loadsON;
+
+    const auto *bytes{ reinterpret_cast< const uint8_t * >(&rec) };
+    uint8_t sum{ 0 };
+    for (uint8_t i = 1; i < sizeof(rec) - 1; ++i)
+    {
+      sum += bytes[i];
+    }
+    rec.checksum = -sum;
+
+    if (Serial.availableForWrite() < static_cast< int >(sizeof(rec)))
+    {
+      ++dropped;
+      return;
+    }
+
+    Serial.write(bytes, sizeof(rec));
+  }
+
+  /**
+   * @brief Number of dropped records since start-up
+   *
+   */
+  static uint16_t get_dropped()
+  {
+    return dropped;
+  }
+
+private:
+  static inline uint16_t dropped{ 0 }; /**< number of dropped records */
+};
+
+inline StreamDatalog streamDatalog; /**< streaming datalog */
+
+#endif /* UTILS_STREAM_H */
@@ -7,6 +7,24 @@
  *
  * @copyright Copyright (c) 2024
  *
+ * @section description Description
+ * The sensors are read by a cooperative state machine, advanced by proceed() on each pass
+ * of loop(). Each call handles exactly one OneWire step: a reset pulse or a single bit slot.
+ * loop() is therefore never held for more than about 1 ms (reset pulse), instead of about
+ * 12 ms per sensor with a blocking scratchpad read.
+ *
+ * Each sensor has its own resolution and polling period (see DeviceAddress).
+ * requestTemperatures() is called every second and collects the sensors which are due.
+ * A conversion is then started for them, all at once (SKIP ROM) when all sensors are due,
+ * otherwise one after the other (MATCH ROM). Once the longest conversion time of the due
+ * sensors has elapsed, they are read back one after the other (MATCH ROM).
+ * The latest values are kept until the next read, get_temperature() never waits.
+ *
+ * At start-up, before the ADC starts, the bus is searched for DS18B20 sensors (bounded by
+ * ONEWIRE_DISCOVERY_TIMEOUT_MS). Each slot (T1, T2, ...) is bound to a sensor by a ROM table
+ * kept in EEPROM, the addresses in config.h are only used when the table is not valid.
+ * A sensor found on the bus but not in the table takes the slot of a sensor which is missing,
+ * so replacing a sensor doesn't need a new build. swapSensors() re-maps two slots.
  */
 
 #ifndef UTILS_TEMP_H
@@ -15,46 +33,84 @@
 #include <Arduino.h>
 
 #include "constants.h"
+#include "utils_pins.h"
 
 #ifdef TEMP_ENABLED
 inline constexpr bool TEMP_SENSOR_PRESENT{ true }; /**< set it to 'true' if temperature sensing is needed */
 #include <OneWire.h>                               // for temperature sensing
+#include <EEPROM.h>                                // for the ROM table
 #else
 inline constexpr bool TEMP_SENSOR_PRESENT{ false }; /**< set it to 'true' if temperature sensing is needed */
 #endif
 
 class OneWire;
 
+inline constexpr uint16_t DS18B20_CONVERSION_TIME_MS{ 750 }; /**< conversion time at 12-bit resolution */
+inline constexpr uint8_t DS18B20_ALARM_HIGH{ 75 };           /**< power-on value of the TH register (unused) */
+inline constexpr uint8_t DS18B20_ALARM_LOW{ 70 };            /**< power-on value of the TL register (unused) */
+inline constexpr uint8_t DS18B20_FAMILY_CODE{ 0x28 };        /**< first byte of the address of a DS18B20 */
+
+inline constexpr uint16_t ONEWIRE_DISCOVERY_TIMEOUT_MS{ 500 }; /**< max duration of the search of the sensors at start-up */
+inline constexpr uint16_t ROM_TABLE_EEPROM_ADDRESS{ 0 };       /**< location of the ROM table in EEPROM */
+inline constexpr uint8_t ROM_TABLE_VERSION{ 1 };               /**< layout version of the ROM table */
+
 /**
  * @struct DeviceAddress
  * @brief Structure representing the address of a device.
  *
  * This structure is used to store the unique address of a device, such as a DS18B20 temperature sensor.
  * The address is an array of 8 bytes, typically represented in hexadecimal.
+ * It's only the default binding of the slot, see the ROM table.
+ * The resolution and the polling period are optional.
  */
 struct DeviceAddress
 {
-  uint8_t addr[8]; /**< The address of the device as an array of 8 bytes. */
+  uint8_t addr[8];          /**< The address of the device as an array of 8 bytes. */
+  uint8_t resolution{ 12 }; /**< The resolution in bits (9 to 12), 10-bit converts 4 times faster than 12-bit. */
+  uint8_t period{ 5 };      /**< The polling period in seconds. */
+};
+
+/**
+ * @brief Temperature limit of a load
+ * @details Within the derating band below the limit, the load only gets a share of the diversion,
+ *          proportional to its distance to the limit. At the limit, it's removed from the diversion.
+ */
+struct LoadTemperatureLimit
+{
+  uint8_t sensor{ 0xff }; /**< index of the sensor (0 for T1), 0xff if the load has no limit */
+  int8_t limit{ 0 };      /**< max temperature in °C */
 };
 
 /**
  * @brief This class implements the temperature sensing feature
- * 
+ *
  * @tparam N Number of sensors, automatically deduced
- * 
+ *
  * @ingroup TemperatureSensing
  */
 template< uint8_t N >
 class TemperatureSensing
 {
   using ScratchPad = uint8_t[9];
+  using RomCode = uint8_t[sizeof(DeviceAddress::addr)];
+
+  /** ROM table, as saved in EEPROM */
+  struct RomTable
+  {
+    uint8_t version; /**< ROM_TABLE_VERSION */
+    uint8_t size;    /**< number of slots */
+    RomCode rom[N];  /**< address of the sensor of each slot */
+    uint8_t crc;     /**< CRC8 of the bytes above */
+  };
+
+  static_assert(N <= 8, "******** Too many temperature sensors (max 8) ! ********");
 
 public:
   constexpr TemperatureSensing() = delete;
 
   /**
    * @brief Construct a new Temperature Sensing object
-   * 
+   *
    * @param pin Pin of the temperature sensor(s)
    * @param ref The list of temperature sensor(s)
    */
@@ -64,34 +120,222 @@ public:
   }
 
   /**
-   * @brief Request temperature for all sensors
+   * @brief Schedule the conversions, to be called every second
+   * @details Only starts the state machine, the conversions and the reads are done by proceed().
+   *          A sensor which becomes due while its previous read is still pending is counted as an overrun.
    *
    */
   void requestTemperatures() const
   {
 #ifdef TEMP_ENABLED
-    oneWire.reset();
-    oneWire.skip();
-    oneWire.write(CONVERT_TEMPERATURE);
+    uint8_t idx{ N };
+    do
+    {
+      --idx;
+      if (!countdown[idx])
+      {
+        if (bit_read(dueSensors, idx))
+        {
+          ++overruns;
+        }
+        bit_set(dueSensors, idx);
+        countdown[idx] = sensorAddrs[idx].period;
+      }
+      --countdown[idx];
+    } while (idx);
+
+    if (OneWireSteps::IDLE != step || !dueSensors)
+    {
+      return;
+    }
+
+    roundSensors = dueSensors;
+    dueSensors = 0;
+
+    conversionTime = 0;
+    idx = N;
+    do
+    {
+      --idx;
+      if (bit_read(roundSensors, idx) && get_conversionTime(idx) > conversionTime)
+      {
+        conversionTime = get_conversionTime(idx);
+      }
+    } while (idx);
+
+    sensorIdx = nextSensor(0);
+    nextStep(OneWireSteps::CONVERT_RESET);
 #endif
   }
 
   /**
    * @brief Initialize the Dallas sensors
+   * @details Searches the bus, binds the sensors to the slots and writes the resolution of each
+   *          sensor to its scratchpad. Blocking, to be called at start-up before the ADC starts.
    *
    */
   void initTemperatureSensors() const
   {
 #ifdef TEMP_ENABLED
     oneWire.begin(sensorPin);
+
+    discoverSensors();
+
+    uint8_t idx{ N };
+    do
+    {
+      --idx;
+      temperatures_x100[idx] = DEVICE_DISCONNECTED_RAW;
+      countdown[idx] = 0;
+
+      writeResolution(idx);
+    } while (idx);
+
     requestTemperatures();
 #endif
   }
 
+  /**
+   * @brief Advance the state machine by one OneWire step
+   * @details To be called on each pass of loop(). Does nothing while idle or while the sensors are converting.
+   *
+   */
+  void proceed() const
+  {
+#ifdef TEMP_ENABLED
+    if (OneWireSteps::IDLE == step)
+    {
+      return;
+    }
+
+    if (OneWireSteps::CONVERTING == step)
+    {
+      if (millis() - conversionStart < conversionTime)
+      {
+        return;
+      }
+      sensorIdx = nextSensor(0);
+      step = OneWireSteps::READ_RESET;
+    }
+
+    const uint16_t start{ static_cast< uint16_t >(micros()) };
+    const bool readDone{ proceedStep() };
+    const uint16_t duration{ static_cast< uint16_t >(static_cast< uint16_t >(micros()) - start) };
+
+    if (duration > maxStepDuration_us)
+    {
+      maxStepDuration_us = duration;
+    }
+    busTime_us += duration;
+
+    if (readDone)
+    {
+      readDuration_us = busTime_us;
+      busTime_us = 0;
+    }
+#endif
+  }
+
+  /**
+   * @brief Get the latest temperature of a specific device
+   *
+   * @param idx The index of the device
+   * @return int16_t Temperature * 100
+   */
+  int16_t get_temperature(const uint8_t idx) const
+  {
+    return temperatures_x100[idx];
+  }
+
+  /**
+   * @brief Longest single OneWire step since start-up (µs)
+   * @details This is the longest time loop() has been held by the temperature sensing.
+   *
+   */
+  uint16_t get_maxStepDuration() const
+  {
+    return maxStepDuration_us;
+  }
+
+  /**
+   * @brief Total bus time of the last sensor read (µs)
+   * @details This is how long a blocking read would have held loop() in one go.
+   *
+   */
+  uint16_t get_readDuration() const
+  {
+    return readDuration_us;
+  }
+
+  /**
+   * @brief Number of polls missed because the previous read of the sensor was not finished
+   *
+   */
+  uint16_t get_overruns() const
+  {
+    return overruns;
+  }
+
+  /**
+   * @brief Swap the sensors of two slots and save the ROM table
+   * @details The resolutions of both sensors are written again (blocking, a few ms).
+   *
+   * @param a The index of the first slot
+   * @param b The index of the second slot
+   * @return true if done, false if a slot is invalid or the bus is busy
+   */
+  bool swapSensors(const uint8_t a, const uint8_t b) const
+  {
+#ifdef TEMP_ENABLED
+    if (a >= N || b >= N || OneWireSteps::IDLE != step)
+    {
+      return false;
+    }
+
+    RomCode rom;
+    memcpy(rom, romTable[a], sizeof(RomCode));
+    memcpy(romTable[a], romTable[b], sizeof(RomCode));
+    memcpy(romTable[b], rom, sizeof(RomCode));
+
+    const int16_t temperature_x100{ temperatures_x100[a] };
+    temperatures_x100[a] = temperatures_x100[b];
+    temperatures_x100[b] = temperature_x100;
+
+    saveRomTable();
+    writeResolution(a);
+    writeResolution(b);
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  /**
+   * @brief Print the address of the sensor of a slot, e.g. "T1: 281BD76A090000B7"
+   *
+   * @param idx The index of the slot
+   * @param out The output
+   */
+  void printSensor(const uint8_t idx, Print &out) const
+  {
+    out.print(F("T"));
+    out.print(idx + 1);
+    out.print(F(": "));
+    for (const auto value : romTable[idx])
+    {
+      if (value < 0x10)
+      {
+        out.print('0');
+      }
+      out.print(value, HEX);
+    }
+    out.println();
+  }
+
   /**
    * @brief Get the number of sensors
-   * 
-   * @return constexpr auto 
+   *
+   * @return constexpr auto
    */
   constexpr auto get_size() const
   {
@@ -100,8 +344,8 @@ public:
 
   /**
    * @brief Get the pin of the sensor(s)
-   * 
-   * @return constexpr auto 
+   *
+   * @return constexpr auto
    */
   constexpr auto get_pin() const
   {
@@ -109,40 +353,382 @@ public:
   }
 
   /**
-   * @brief Read temperature of a specific device
+   * @brief Get the conversion time of a specific device
    *
    * @param idx The index of the device
-   * @return int16_t Temperature * 100
+   * @return constexpr uint16_t The conversion time in ms
    */
-  int16_t readTemperature(const uint8_t idx) const
+  constexpr uint16_t get_conversionTime(const uint8_t idx) const
+  {
+    return (DS18B20_CONVERSION_TIME_MS >> (12 - sensorAddrs[idx].resolution)) + 1;
+  }
+
+  /**
+   * @brief Check the resolution and the polling period of all sensors
+   *
+   * @return true if the settings are valid
+   */
+  constexpr bool check_settings() const
+  {
+    for (const auto &sensor : sensorAddrs)
+    {
+      if (sensor.resolution < 9 || sensor.resolution > 12 || !sensor.period)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  /** Steps of the state machine */
+  enum class OneWireSteps : uint8_t
   {
-    static ScratchPad buf;
+    IDLE,          /**< nothing to do */
+    CONVERT_RESET, /**< reset pulse before the conversion */
+    CONVERT_WRITE, /**< SKIP ROM or MATCH ROM + address, CONVERT T */
+    CONVERTING,    /**< waiting for the end of the conversion */
+    READ_RESET,    /**< reset pulse before reading a sensor */
+    READ_WRITE,    /**< MATCH ROM, address of the sensor, READ SCRATCHPAD */
+    READ_DATA      /**< the 9 bytes of the scratchpad */
+  };
 
+  static constexpr uint8_t ALL_SENSORS{ static_cast< uint8_t >((1U << N) - 1) }; /**< mask of all sensors */
+
+  /**
+   * @brief Handle one reset pulse or one bit slot
+   *
+   * @return true if the read of a sensor has just been completed
+   */
+  bool proceedStep() const
+  {
 #ifdef TEMP_ENABLED
-    if (!oneWire.reset())
+    switch (step)
     {
-      return DEVICE_DISCONNECTED_RAW;
+      case OneWireSteps::CONVERT_RESET:
+        if (!oneWire.reset())
+        {
+          sensorIdx = nextSensor(0);  // no sensor on the bus, the reads will report them as disconnected
+          nextStep(OneWireSteps::READ_RESET);
+          return false;
+        }
+        nextStep(OneWireSteps::CONVERT_WRITE);
+        return false;
+
+      case OneWireSteps::CONVERT_WRITE:
+        if (ALL_SENSORS == roundSensors)
+        {
+          writeBit(byteIdx ? CONVERT_TEMPERATURE : SKIP_ROM);
+          if (2 == byteIdx)
+          {
+            startConversion();
+          }
+          return false;
+        }
+        if (writeAddressedCommand(CONVERT_TEMPERATURE))
+        {
+          sensorIdx = nextSensor(sensorIdx + 1);
+          if (sensorIdx < N)
+          {
+            step = OneWireSteps::CONVERT_RESET;
+          }
+          else
+          {
+            startConversion();
+          }
+        }
+        return false;
+
+      case OneWireSteps::READ_RESET:
+        if (!oneWire.reset())
+        {
+          return storeTemperature(DEVICE_DISCONNECTED_RAW);
+        }
+        nextStep(OneWireSteps::READ_WRITE);
+        return false;
+
+      case OneWireSteps::READ_WRITE:
+        if (writeAddressedCommand(READ_SCRATCHPAD))
+        {
+          nextStep(OneWireSteps::READ_DATA);
+        }
+        return false;
+
+      case OneWireSteps::READ_DATA:
+        if (1 == bitMask)
+        {
+          scratchPad[byteIdx] = 0;
+        }
+        if (oneWire.read_bit())
+        {
+          scratchPad[byteIdx] |= bitMask;
+        }
+        if (!(bitMask <<= 1))
+        {
+          bitMask = 1;
+          if (++byteIdx == sizeof(ScratchPad))
+          {
+            return storeTemperature(decodeScratchPad());
+          }
+        }
+        return false;
+
+      default:
+        return false;
     }
-    oneWire.select(sensorAddrs[idx].addr);
-    oneWire.write(READ_SCRATCHPAD);
+#else
+    return false;
+#endif
+  }
+
+  /**
+   * @brief Search the bus and bind the sensors to the slots
+   * @details The search stops after ONEWIRE_DISCOVERY_TIMEOUT_MS, the remaining sensors are ignored.
+   *          The ROM table is only written to EEPROM when it has changed.
+   *
+   */
+  void discoverSensors() const
+  {
+#ifdef TEMP_ENABLED
+    RomTable table;
+    EEPROM.get(ROM_TABLE_EEPROM_ADDRESS, table);
+
+    bool changed{ ROM_TABLE_VERSION != table.version || N != table.size || crc8(table) != table.crc };
+
+    uint8_t idx{ N };
+    do
+    {
+      --idx;
+      memcpy(romTable[idx], changed ? sensorAddrs[idx].addr : table.rom[idx], sizeof(RomCode));
+    } while (idx);
 
-    for (auto &buf_elem : buf)
+    uint8_t present{ 0 };
+    RomCode unknown[N];
+    uint8_t nbUnknown{ 0 };
+    RomCode rom;
+
+    const auto start{ millis() };
+    oneWire.reset_search();
+    while (millis() - start < ONEWIRE_DISCOVERY_TIMEOUT_MS && oneWire.search(rom))
     {
-      buf_elem = oneWire.read();
+      if (DS18B20_FAMILY_CODE != rom[0] || oneWire.crc8(rom, 7) != rom[7])
+      {
+        continue;
+      }
+
+      idx = findSlot(rom);
+      if (idx < N)
+      {
+        bit_set(present, idx);
+      }
+      else if (nbUnknown < N)
+      {
+        memcpy(unknown[nbUnknown++], rom, sizeof(RomCode));
+      }
     }
 
-    if (!oneWire.reset())
+    // a new sensor takes the slot of a missing one
+    uint8_t next{ 0 };
+    for (idx = 0; idx < N && next < nbUnknown; ++idx)
     {
-      return DEVICE_DISCONNECTED_RAW;
+      if (!bit_read(present, idx))
+      {
+        memcpy(romTable[idx], unknown[next++], sizeof(RomCode));
+        changed = true;
+      }
     }
-    if (oneWire.crc8(buf, 8) != buf[8])
+
+    if (changed)
+    {
+      saveRomTable();
+    }
+#endif
+  }
+
+  /**
+   * @brief Find the slot of a sensor
+   *
+   * @param rom The address of the sensor
+   * @return uint8_t The index of the slot, N if the sensor is unknown
+   */
+  uint8_t findSlot(const RomCode &rom) const
+  {
+    uint8_t idx{ 0 };
+    while (idx < N && memcmp(romTable[idx], rom, sizeof(RomCode)))
+    {
+      ++idx;
+    }
+    return idx;
+  }
+
+  /**
+   * @brief Save the ROM table to EEPROM (only the changed bytes are written)
+   *
+   */
+  void saveRomTable() const
+  {
+#ifdef TEMP_ENABLED
+    RomTable table;
+    table.version = ROM_TABLE_VERSION;
+    table.size = N;
+    memcpy(table.rom, romTable, sizeof(romTable));
+    table.crc = crc8(table);
+
+    EEPROM.put(ROM_TABLE_EEPROM_ADDRESS, table);
+#endif
+  }
+
+  /**
+   * @brief CRC8 of a ROM table, without its CRC
+   *
+   */
+  static uint8_t crc8(const RomTable &table)
+  {
+#ifdef TEMP_ENABLED
+    return OneWire::crc8(reinterpret_cast< const uint8_t * >(&table), sizeof(RomTable) - 1);
+#else
+    return 0;
+#endif
+  }
+
+  /**
+   * @brief Write the resolution of the sensor of a slot (blocking)
+   *
+   * @param idx The index of the slot
+   */
+  void writeResolution(const uint8_t idx) const
+  {
+#ifdef TEMP_ENABLED
+    if (oneWire.reset())
+    {
+      oneWire.select(romTable[idx]);
+      oneWire.write(WRITE_SCRATCH);
+      oneWire.write(DS18B20_ALARM_HIGH);
+      oneWire.write(DS18B20_ALARM_LOW);
+      oneWire.write(((sensorAddrs[idx].resolution - 9) << 5) | 0x1F);
+    }
+#endif
+  }
+
+  /**
+   * @brief Switch to a new step, starting with the first bit of the first byte
+   *
+   */
+  void nextStep(OneWireSteps newStep) const
+  {
+    step = newStep;
+    byteIdx = 0;
+    bitMask = 1;
+  }
+
+  /**
+   * @brief Write the current bit of a byte (LSB first)
+   *
+   * @param value The byte being written
+   */
+  void writeBit(uint8_t value) const
+  {
+#ifdef TEMP_ENABLED
+    oneWire.write_bit(value & bitMask);
+#endif
+    if (!(bitMask <<= 1))
+    {
+      bitMask = 1;
+      ++byteIdx;
+    }
+  }
+
+  /**
+   * @brief Write the current bit of MATCH ROM, the address of the current sensor and a command
+   *
+   * @param command The command
+   * @return true if the last bit of the command has been written
+   */
+  bool writeAddressedCommand(uint8_t command) const
+  {
+    constexpr uint8_t ADDR_SIZE{ sizeof(DeviceAddress::addr) };
+
+    if (!byteIdx)
+    {
+      writeBit(MATCH_ROM);
+    }
+    else if (byteIdx <= ADDR_SIZE)
+    {
+      writeBit(romTable[sensorIdx][byteIdx - 1]);
+    }
+    else
+    {
+      writeBit(command);
+    }
+    return byteIdx > ADDR_SIZE + 1;
+  }
+
+  /**
+   * @brief Start waiting for the end of the conversion
+   *
+   */
+  void startConversion() const
+  {
+    conversionStart = millis();
+    step = OneWireSteps::CONVERTING;
+  }
+
+  /**
+   * @brief Find the next sensor of the current round
+   *
+   * @param idx The first index to look at
+   * @return uint8_t The index of the sensor, N if there's none left
+   */
+  uint8_t nextSensor(uint8_t idx) const
+  {
+    while (idx < N && !bit_read(roundSensors, idx))
+    {
+      ++idx;
+    }
+    return idx;
+  }
+
+  /**
+   * @brief Store the temperature of the current sensor and go on with the next one
+   * @details If the sensor reads 85°C (its power-on value) and the delta with the previous
+   *          value is greater than 5°C, the value is discarded.
+   *
+   * @param value The temperature * 100
+   * @return true
+   */
+  bool storeTemperature(int16_t value) const
+  {
+    if (8500 == value && (abs(value - temperatures_x100[sensorIdx]) > 500))
+    {
+      value = DEVICE_DISCONNECTED_RAW;
+    }
+    temperatures_x100[sensorIdx] = value;
+
+    sensorIdx = nextSensor(sensorIdx + 1);
+    nextStep(sensorIdx < N ? OneWireSteps::READ_RESET : OneWireSteps::IDLE);
+
+    return true;
+  }
+
+  /**
+   * @brief Check and convert the scratchpad
+   *
+   * @return int16_t Temperature * 100
+   */
+  int16_t decodeScratchPad() const
+  {
+#ifdef TEMP_ENABLED
+    if (oneWire.crc8(scratchPad, 8) != scratchPad[8])
     {
       return DEVICE_DISCONNECTED_RAW;
     }
 #endif
 
-    // result is temperature x16, multiply by 6.25 to convert to temperature x100
-    int16_t result = (buf[1] << 8) | buf[0];
+    // result is temperature x16, the lowest bits are undefined below 12-bit resolution
+    int16_t result = (scratchPad[1] << 8) | scratchPad[0];
+    result &= ~((1 << (12 - sensorAddrs[sensorIdx].resolution)) - 1);
+
+    // multiply by 6.25 to convert to temperature x100
     result = (result * 6) + (result >> 2);
     if (result <= TEMP_RANGE_LOW || result >= TEMP_RANGE_HIGH)
     {
@@ -152,12 +738,30 @@ public:
     return result;
   }
 
-private:
   const uint8_t sensorPin; /**< The pin of the sensor(s) */
 
-  const DeviceAddress sensorAddrs[N]; /**< Array of sensors */
+  const DeviceAddress sensorAddrs[N]; /**< Array of sensors (default bindings, resolutions and periods) */
 
   static inline OneWire oneWire; /**< For temperature sensing */
+
+  static inline RomCode romTable[N];          /**< address of the sensor of each slot */
+  static inline int16_t temperatures_x100[N]; /**< latest temperatures */
+  static inline ScratchPad scratchPad;        /**< scratchpad being read */
+  static inline uint8_t countdown[N];         /**< seconds before each sensor is due */
+
+  static inline OneWireSteps step{ OneWireSteps::IDLE }; /**< current step of the state machine */
+  static inline uint8_t dueSensors{ 0 };                 /**< sensors waiting for the next round */
+  static inline uint8_t roundSensors{ 0 };               /**< sensors of the current round */
+  static inline uint8_t sensorIdx{ 0 };                  /**< sensor being converted or read */
+  static inline uint8_t byteIdx{ 0 };                    /**< byte being written or read */
+  static inline uint8_t bitMask{ 1 };                    /**< bit being written or read */
+  static inline uint16_t conversionTime{ 0 };            /**< conversion time of the current round (ms) */
+  static inline uint32_t conversionStart{ 0 };           /**< start of the conversion (ms) */
+
+  static inline uint16_t busTime_us{ 0 };         /**< bus time of the read in progress */
+  static inline uint16_t readDuration_us{ 0 };    /**< bus time of the last complete read */
+  static inline uint16_t maxStepDuration_us{ 0 }; /**< longest single step */
+  static inline uint16_t overruns{ 0 };           /**< number of missed polls */
 };
 
-#endif  // UTILS_TEMP_H
\ No newline at end of file
+#endif  // UTILS_TEMP_H
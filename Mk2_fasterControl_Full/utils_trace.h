@@ -0,0 +1,282 @@
+/**
+ * @file utils_trace.h
+ * @author Frédéric Metrich (frederic.metrich@live.fr)
+ * @brief Per-mains-cycle trace capture, frozen on trigger and dumped to the Serial output
+ * @version 0.1
+ * @date 2024-11-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ * @section description Description
+ * The datalog averages everything over several seconds, which hides the sub-second behaviour
+ * of the control loop. When TRACE_CAPTURE is enabled, the ISR stores one small record per
+ * mains cycle in a ring buffer:
+ *  - grid (import +ve in the dump) and diverted energy of the cycle
+ *  - predicted level of the energy bucket
+ *  - state of the physical loads (1 bit per load)
+ *  - number of sample sets of the cycle
+ *
+ * Recording goes on until a trigger fires (import spike, lost samples or load toggle storm).
+ * Half a buffer is then still recorded, so that the dump shows what happened before
+ * and after the event. The buffer is then frozen and dumped line by line from loop(),
+ * without blocking. Recording resumes once the dump is complete.
+ */
+
+#ifndef UTILS_TRACE_H
+#define UTILS_TRACE_H
+
+#include <Arduino.h>
+
+#include "calibration.h"
+#include "config.h"
+#include "utils_pins.h"
+#include "utils_serial.h"
+#include "utils_settings.h"
+
+inline constexpr uint8_t TRACE_BUFFER_SIZE{ 32 };                     /**< number of records (mains cycles), must be a power of 2 */
+inline constexpr uint8_t TRACE_POST_TRIGGER{ TRACE_BUFFER_SIZE / 2 }; /**< number of records kept after the trigger */
+inline constexpr uint8_t TRACE_ENERGY_SHIFT{ 4 };                     /**< scaling of the grid/diverted energy in the records */
+inline constexpr uint8_t TRACE_BUCKET_SHIFT{ 5 };                     /**< scaling of the energy bucket in the records */
+inline constexpr uint8_t TRACE_LINE_LENGTH{ 52 };                     /**< room needed in the UART buffer to print one line */
+
+static_assert((TRACE_BUFFER_SIZE & (TRACE_BUFFER_SIZE - 1)) == 0, "TRACE_BUFFER_SIZE must be a power of 2 !");
+static_assert(NO_OF_DUMPLOADS <= 8, "******** Trace capture supports up to 8 loads ! ********");
+static_assert(!TRACE_CAPTURE | !EMONESP_CONTROL, "******** Trace capture uses the Serial output, it cannot be used with EmonESP ! ********");
+
+inline int32_t traceImportSpike_IEU{ static_cast< int32_t >(TRACE_IMPORT_SPIKE_IN_WATTS * (1 / powerCal_grid)) }; /**< import spike threshold, updated by applySettings() */
+
+/** nominal number of sample sets per mains cycle (3 conversions of 13 ADC clocks, ADC clock = F_CPU / 128) */
+inline constexpr uint8_t TRACE_NOMINAL_SAMPLE_SETS{ F_CPU / (3UL * 13UL * 128UL) / SUPPLY_FREQUENCY };
+inline constexpr uint8_t TRACE_MIN_SAMPLE_SETS{ TRACE_NOMINAL_SAMPLE_SETS - 2 }; /**< below this value, samples have been lost */
+
+/** Trace triggers */
+enum class TraceTriggers : uint8_t
+{
+  NONE,         /**< not triggered yet */
+  IMPORT_SPIKE, /**< grid import above TRACE_IMPORT_SPIKE_IN_WATTS */
+  LOST_SAMPLES, /**< less sample sets than expected during a mains cycle */
+  TOGGLE_STORM  /**< loads toggled at least TRACE_TOGGLE_STORM times within one second */
+};
+
+/** One mains cycle, 8 bytes */
+struct TraceRecord
+{
+  int16_t grid;       /**< realEnergy_grid >> TRACE_ENERGY_SHIFT */
+  int16_t diverted;   /**< realEnergy_diverted >> TRACE_ENERGY_SHIFT */
+  int16_t bucket;     /**< energyInBucket_prediction >> TRACE_BUCKET_SHIFT */
+  uint8_t loadsON;    /**< bit i is set when the physical load #i is ON */
+  uint8_t sampleSets; /**< sample sets during the mains cycle */
+};
+
+/**
+ * @brief Ring buffer of per-mains-cycle records
+ * @details The ISR only writes while the buffer is not frozen, loop() only reads while it is.
+ *
+ * @ingroup TimeCritical
+ */
+class TraceBuffer
+{
+public:
+  /**
+   * @brief Store the record of the last mains cycle and check the triggers
+   * @details Called from the ISR, once per mains cycle.
+   *
+   * @param realEnergy_grid Grid energy of the cycle (IEU)
+   * @param realEnergy_diverted Diverted energy of the cycle (IEU)
+   * @param energyInBucket_prediction Predicted level of the energy bucket (IEU)
+   * @param loadsON Bit field of the physical loads which are ON
+   * @param sampleSets Number of sample sets of the cycle
+   */
+  static void record(int32_t realEnergy_grid, int32_t realEnergy_diverted, int32_t energyInBucket_prediction, uint8_t loadsON, uint8_t sampleSets)
+  {
+    if (frozen)
+    {
+      return;
+    }
+
+    auto &rec{ records[next] };
+    rec.grid = pack(realEnergy_grid >> TRACE_ENERGY_SHIFT);
+    rec.diverted = pack(realEnergy_diverted >> TRACE_ENERGY_SHIFT);
+    rec.bucket = pack(energyInBucket_prediction >> TRACE_BUCKET_SHIFT);
+    rec.loadsON = loadsON;
+    rec.sampleSets = sampleSets;
+
+    next = (next + 1) & TRACE_MASK;
+    if (filled < TRACE_BUFFER_SIZE)
+    {
+      ++filled;
+    }
+
+    if (loadsON != lastLoadsON)
+    {
+      lastLoadsON = loadsON;
+      ++toggles;
+    }
+
+    if (trigger != TraceTriggers::NONE)
+    {
+      if (!--postTriggerCount)
+      {
+        frozen = true;
+      }
+    }
+    else if (realEnergy_grid < -traceImportSpike_IEU)  // the grid energy is negative on import
+    {
+      trigger = TraceTriggers::IMPORT_SPIKE;
+    }
+    else if (sampleSets < TRACE_MIN_SAMPLE_SETS)
+    {
+      trigger = TraceTriggers::LOST_SAMPLES;
+    }
+    else if (toggles >= TRACE_TOGGLE_STORM)
+    {
+      trigger = TraceTriggers::TOGGLE_STORM;
+    }
+
+    if (++cycleCount >= SUPPLY_FREQUENCY)
+    {
+      cycleCount = 0;
+      toggles = 0;
+    }
+  }
+
+  /**
+   * @brief Print the next line of a frozen trace
+   * @details To be called on each pass of loop(). A line is only printed when no other output
+   *          is pending and the UART buffer can take it without blocking.
+   *          Recording resumes once the whole trace has been printed.
+   *
+   */
+  static void proceedDump()
+  {
+    if (!frozen || SerialTxQueueBase::size() || Serial.availableForWrite() < TRACE_LINE_LENGTH + TX_RESERVED_ROOM)
+    {
+      return;
+    }
+
+    if (dumpIndex < TRACE_HEADER_LINES)
+    {
+      printHeader(dumpIndex);
+    }
+    else
+    {
+      // records are printed from the oldest one, the trigger is cycle 0
+      const uint8_t pos{ static_cast< uint8_t >(dumpIndex - TRACE_HEADER_LINES) };
+      printRecord(static_cast< int16_t >(pos) - (filled - TRACE_POST_TRIGGER - 1), records[(next - filled + pos) & TRACE_MASK]);
+    }
+
+    if (++dumpIndex >= filled + TRACE_HEADER_LINES)
+    {
+      rearm();
+    }
+  }
+
+private:
+  static constexpr uint8_t TRACE_MASK{ TRACE_BUFFER_SIZE - 1 };
+  static constexpr uint8_t TRACE_HEADER_LINES{ 2 };
+
+  /**
+   * @brief Saturate a value to 16 bits
+   *
+   */
+  static int16_t pack(int32_t value)
+  {
+    if (value > INT16_MAX)
+    {
+      return INT16_MAX;
+    }
+    if (value < INT16_MIN)
+    {
+      return INT16_MIN;
+    }
+    return value;
+  }
+
+  /**
+   * @brief Print one line of the header
+   *
+   * @param line 0 for the cause of the trigger, 1 for the column names
+   */
+  static void printHeader(uint8_t line)
+  {
+    if (line)
+    {
+      Serial.println(F("cycle,grid_W,diverted_W,bucket_J,loads,sampleSets"));
+      return;
+    }
+
+    Serial.print(F("Trace: "));
+    switch (trigger)
+    {
+      case TraceTriggers::IMPORT_SPIKE:
+        Serial.println(F("import spike"));
+        break;
+      case TraceTriggers::LOST_SAMPLES:
+        Serial.println(F("lost samples"));
+        break;
+      default:
+        Serial.println(F("toggle storm"));
+        break;
+    }
+  }
+
+  /**
+   * @brief Print one record, energies are converted back to physical units
+   *
+   * @param cycle Cycle number relative to the trigger
+   * @param rec The record
+   */
+  static void printRecord(int16_t cycle, const TraceRecord &rec)
+  {
+    Serial.print(cycle);
+    Serial.print(',');
+    Serial.print(static_cast< int32_t >((static_cast< int32_t >(rec.grid) << TRACE_ENERGY_SHIFT) * -settings.gridPowerCal));  // import +ve, as in the datalog
+    Serial.print(',');
+    Serial.print(static_cast< int32_t >((static_cast< int32_t >(rec.diverted) << TRACE_ENERGY_SHIFT) * settings.divertedPowerCal));
+    Serial.print(',');
+    Serial.print(static_cast< int32_t >((static_cast< int32_t >(rec.bucket) << TRACE_BUCKET_SHIFT) * settings.gridPowerCal * invSUPPLY_FREQUENCY));
+    Serial.print(',');
+
+    uint8_t i{ NO_OF_DUMPLOADS };
+    do
+    {
+      --i;
+      Serial.print(bit_read(rec.loadsON, i) ? '1' : '0');
+    } while (i);
+
+    Serial.print(',');
+    Serial.println(rec.sampleSets);
+  }
+
+  /**
+   * @brief Restart the recording after a dump
+   *
+   */
+  static void rearm()
+  {
+    dumpIndex = 0;
+    filled = 0;
+    toggles = 0;
+    trigger = TraceTriggers::NONE;
+    postTriggerCount = TRACE_POST_TRIGGER;
+    frozen = false;  // must be the last one, the ISR starts writing again
+  }
+
+  static inline TraceRecord records[TRACE_BUFFER_SIZE]; /**< ring buffer */
+  static inline uint8_t next{ 0 };                      /**< index of the next record to be written */
+  static inline uint8_t filled{ 0 };                    /**< number of valid records */
+
+  static inline TraceTriggers trigger{ TraceTriggers::NONE };   /**< cause of the trigger */
+  static inline uint8_t postTriggerCount{ TRACE_POST_TRIGGER }; /**< records still to be written after the trigger */
+  static inline volatile bool frozen{ false };                  /**< set by the ISR, cleared by loop() once dumped */
+
+  static inline uint8_t lastLoadsON{ 0 }; /**< loads state of the previous cycle */
+  static inline uint8_t toggles{ 0 };     /**< number of load toggles during the current second */
+  static inline uint8_t cycleCount{ 0 };  /**< mains cycles in the current second */
+
+  static inline uint8_t dumpIndex{ 0 }; /**< next line to be dumped, 0 is the header */
+};
+
+inline TraceBuffer traceBuffer; /**< per-cycle trace buffer */
+
+#endif /* UTILS_TRACE_H */
@@ -0,0 +1,288 @@
+/**
+ * @file utils_twi.h
+ * @author Frédéric Metrich (frederic.metrich@live.fr)
+ * @brief Interrupt-driven, non-blocking I2C (TWI) output for the OLED display
+ * @version 0.1
+ * @date 2024-12-01
+ *
+ * @copyright Copyright (c) 2024
+ *
+ * @section description Description
+ * With the Wire library, each transfer to the display waits in loop() until the last
+ * byte has been sent, and a full screen takes tens of ms.
+ *
+ * Here, u8x8 hands its I2C transfers over to a small ring buffer, and the TWI interrupt
+ * sends them on its own, one byte per interrupt. The TWI interrupt is never longer than
+ * a few dozen cycles, so an ADC interrupt is never delayed by more than that.
+ * loop() only waits when the ring buffer is full, i.e. when more than TWI_TX_BUFFER_SIZE
+ * bytes are pending, which only happens for large redraws (logo, clear screen).
+ *
+ * In the ring buffer, each transfer is stored as: length of the data, I2C address, data.
+ * A transfer only becomes visible to the interrupt once it's complete.
+ */
+
+#ifndef UTILS_TWI_H
+#define UTILS_TWI_H
+
+#include <Arduino.h>
+#include <U8g2lib.h>
+#include <util/twi.h>
+
+inline constexpr uint8_t TWI_TX_BUFFER_SIZE{ 64 };        /**< size of the ring buffer, must be a power of 2 */
+inline constexpr uint32_t TWI_FREQUENCY{ 400000UL };      /**< I2C clock (fast mode) */
+inline constexpr uint8_t TWI_MAX_TRANSFER_SIZE{ 1 + 24 }; /**< largest transfer of u8x8 for the SSD1306 (control byte + 24 data bytes) */
+
+static_assert((TWI_TX_BUFFER_SIZE & (TWI_TX_BUFFER_SIZE - 1)) == 0, "TWI_TX_BUFFER_SIZE must be a power of 2 !");
+static_assert(TWI_TX_BUFFER_SIZE >= 2 * (TWI_MAX_TRANSFER_SIZE + 2), "******** TWI_TX_BUFFER_SIZE is too small ! ********");
+static_assert((F_CPU / TWI_FREQUENCY - 16) / 2 <= UINT8_MAX, "******** TWI_FREQUENCY is too low ! ********");
+
+/**
+ * @brief Non-blocking TWI transmitter
+ * @details All members are static: there's only one TWI unit.
+ *
+ * @ingroup OLEDDisplay
+ */
+class AsyncTWI
+{
+public:
+  /**
+   * @brief Initialize the TWI unit as master transmitter
+   *
+   */
+  static void initialize()
+  {
+    // internal pull-ups on SDA/SCL, like the Wire library
+    pinMode(SDA, INPUT_PULLUP);
+    pinMode(SCL, INPUT_PULLUP);
+
+    TWSR = 0;  // prescaler 1
+    TWBR = (F_CPU / TWI_FREQUENCY - 16) / 2;
+    TWCR = bit(TWEN);
+
+    head = tail = 0;
+    busy = false;
+  }
+
+  /**
+   * @brief Open a new transfer
+   *
+   * @param address The I2C address (already shifted, R/W bit cleared)
+   */
+  static void beginTransfer(uint8_t address)
+  {
+    lengthIndex = tail;
+    writeIndex = tail;
+    push(0);  // placeholder for the length
+    push(address);
+    transferLength = 0;
+  }
+
+  /**
+   * @brief Add data to the current transfer
+   * @details Waits (with interrupts enabled) only if the ring buffer is full.
+   *
+   * @param data The data
+   * @param len The number of bytes
+   */
+  static void write(const uint8_t *data, uint8_t len)
+  {
+    while (len--)
+    {
+      push(*data++);
+      ++transferLength;
+    }
+  }
+
+  /**
+   * @brief Close the current transfer and start sending it if the bus is idle
+   *
+   */
+  static void endTransfer()
+  {
+    buffer[lengthIndex] = transferLength;
+
+    const uint8_t oldSREG{ SREG };
+    cli();
+    tail = writeIndex;  // the transfer is now visible to the interrupt
+    if (!busy)
+    {
+      busy = true;
+      start();
+    }
+    SREG = oldSREG;
+  }
+
+  /**
+   * @brief Return true if nothing is pending anymore
+   *
+   */
+  static bool idle()
+  {
+    return !busy;
+  }
+
+  /**
+   * @brief Number of transfers aborted by a bus error or a missing acknowledge
+   *
+   */
+  static uint16_t get_errors()
+  {
+    return errors;
+  }
+
+  /**
+   * @brief Send the next byte, called from the TWI interrupt
+   * @details Exactly one byte is handled per interrupt.
+   *
+   */
+  static void proceed()
+  {
+    switch (TW_STATUS)
+    {
+      case TW_START:
+      case TW_REP_START:
+        remaining = pop();
+        TWDR = pop();  // address
+        TWCR = bit(TWEN) | bit(TWIE) | bit(TWINT);
+        break;
+
+      case TW_MT_SLA_ACK:
+      case TW_MT_DATA_ACK:
+        if (remaining)
+        {
+          --remaining;
+          TWDR = pop();
+          TWCR = bit(TWEN) | bit(TWIE) | bit(TWINT);
+          break;
+        }
+        stopAndNext();
+        break;
+
+      default:  // no acknowledge, arbitration lost or bus error: the transfer is dropped
+        ++errors;
+        while (remaining)
+        {
+          --remaining;
+          pop();
+        }
+        stopAndNext();
+        break;
+    }
+  }
+
+private:
+  static constexpr uint8_t TWI_MASK{ TWI_TX_BUFFER_SIZE - 1 };
+
+  /**
+   * @brief Append one byte to the transfer being written
+   *
+   */
+  static void push(uint8_t value)
+  {
+    const uint8_t next{ static_cast< uint8_t >((writeIndex + 1) & TWI_MASK) };
+    while (next == head)
+    {
+      // ring buffer full, the interrupt is sending
+    }
+    buffer[writeIndex] = value;
+    writeIndex = next;
+  }
+
+  /**
+   * @brief Take the next byte to be sent
+   *
+   */
+  static uint8_t pop()
+  {
+    const uint8_t value{ buffer[head] };
+    head = (head + 1) & TWI_MASK;
+    return value;
+  }
+
+  /**
+   * @brief Send a START condition
+   *
+   */
+  static void start()
+  {
+    while (TWCR & bit(TWSTO))
+    {
+      // the previous STOP is still being sent (a few µs)
+    }
+    TWCR = bit(TWEN) | bit(TWIE) | bit(TWINT) | bit(TWSTA);
+  }
+
+  /**
+   * @brief Send a STOP condition, followed by a START if another transfer is queued
+   *
+   */
+  static void stopAndNext()
+  {
+    if (head != tail)
+    {
+      TWCR = bit(TWEN) | bit(TWIE) | bit(TWINT) | bit(TWSTO) | bit(TWSTA);
+      return;
+    }
+    TWCR = bit(TWEN) | bit(TWINT) | bit(TWSTO);
+    busy = false;
+  }
+
+  static inline uint8_t buffer[TWI_TX_BUFFER_SIZE]; /**< ring buffer of transfers */
+  static inline volatile uint8_t head{ 0 };         /**< next byte to be sent, moved by the interrupt */
+  static inline volatile uint8_t tail{ 0 };         /**< end of the last complete transfer */
+  static inline volatile bool busy{ false };        /**< true while the interrupt is sending */
+
+  static inline uint8_t writeIndex{ 0 };     /**< end of the transfer being written */
+  static inline uint8_t lengthIndex{ 0 };    /**< position of the length of the transfer being written */
+  static inline uint8_t transferLength{ 0 }; /**< data bytes of the transfer being written */
+  static inline uint8_t remaining{ 0 };      /**< data bytes still to be sent for the current transfer */
+
+  static inline volatile uint16_t errors{ 0 }; /**< number of aborted transfers */
+};
+
+/**
+ * @brief u8x8 byte callback, hands the I2C transfers over to AsyncTWI
+ *
+ * @ingroup OLEDDisplay
+ */
+inline uint8_t u8x8_byte_async_twi(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int, void *arg_ptr)
+{
+  switch (msg)
+  {
+    case U8X8_MSG_BYTE_INIT:
+      AsyncTWI::initialize();
+      break;
+    case U8X8_MSG_BYTE_START_TRANSFER:
+      AsyncTWI::beginTransfer(u8x8_GetI2CAddress(u8x8));
+      break;
+    case U8X8_MSG_BYTE_SEND:
+      AsyncTWI::write(static_cast< const uint8_t * >(arg_ptr), arg_int);
+      break;
+    case U8X8_MSG_BYTE_END_TRANSFER:
+      AsyncTWI::endTransfer();
+      break;
+    case U8X8_MSG_BYTE_SET_DC:
+      break;
+    default:
+      return 0;
+  }
+  return 1;
+}
+
+/**
+ * @brief SSD1306 128x64 display, driven through AsyncTWI
+ *
+ * @ingroup OLEDDisplay
+ */
+class U8X8_SSD1306_128X64_NONAME_ASYNC_I2C : public U8X8
+{
+public:
+  explicit U8X8_SSD1306_128X64_NONAME_ASYNC_I2C(uint8_t reset = U8X8_PIN_NONE)
+    : U8X8()
+  {
+    u8x8_Setup(getU8x8(), u8x8_d_ssd1306_128x64_noname, u8x8_cad_ssd13xx_fast_i2c, u8x8_byte_async_twi, u8x8_gpio_and_delay_arduino);
+    u8x8_SetPin(getU8x8(), U8X8_PIN_RESET, reset);
+  }
+};
+
+#endif /* UTILS_TWI_H */
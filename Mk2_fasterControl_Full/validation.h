@@ -16,6 +16,9 @@
 #include "utils_pins.h"
 
 #include "config.h"
+#include "processing.h"
+#include "utils_energy.h"
+#include "utils_settings.h"
 
 /**
  * @note All these checks are done by the compiler.
@@ -26,21 +29,56 @@
  */
 
 static_assert(DATALOG_PERIOD_IN_SECONDS <= 40, "**** Data log duration is too long and will lead to overflow ! ****");
+static_assert(!EMONESP_CONTROL | (SERIAL_BAUD_RATE == 9600), "**** EmonESP expects the Serial output at 9600 baud ! ****");
 
 static_assert(TEMP_SENSOR_PRESENT ^ (temperatureSensing.get_pin() == 0xff), "******** Wrong pin value for temperature sensor(s). Please check your config.h ! ********");
+static_assert(ONEWIRE_DISCOVERY_TIMEOUT_MS < startUpPeriod, "******** The search of the temperature sensors must end before the start-up period ! ********");
+static_assert(TEMPERATURE_DERATING_BAND && DERATING_WINDOW_IN_SECONDS, "******** The derating band and window cannot be zero. Please check your config.h ! ********");
+static_assert(temperatureSensing.check_settings(), "******** Wrong resolution (9 to 12) or polling period (at least 1 s) for temperature sensor(s). Please check your config.h ! ********");
 static_assert(DIVERSION_PIN_PRESENT ^ (diversionPin == 0xff), "******** Wrong pin value for diversion command. Please check your config.h ! ********");
 static_assert((PRIORITY_ROTATION == RotationModes::PIN) ^ (rotationPin == 0xff), "******** Wrong pin value for rotation command. Please check your config.h ! ********");
 static_assert(OVERRIDE_PIN_PRESENT ^ (forcePin == 0xff), "******** Wrong pin value for override command. Please check your config.h ! ********");
 static_assert(WATCHDOG_PIN_PRESENT ^ (watchDogPin == 0xff), "******** Wrong pin value for watchdog. Please check your config.h ! ********");
+#ifndef OLED_PRESENT
+static_assert(TYPE_OF_DISPLAY != DisplayType::OLED, "******** The OLED display needs OLED_PRESENT. Please check your config.h ! ********");
+#endif
 
 static_assert(DUAL_TARIFF ^ (dualTariffPin == 0xff), "******** Wrong pin value for dual tariff. Please check your config.h ! ********");
 static_assert(!DUAL_TARIFF | (ul_OFF_PEAK_DURATION == 0), "******** Off-peak duration cannot be zero. Please check your config.h ! ********");
 static_assert(!(DUAL_TARIFF & (ul_OFF_PEAK_DURATION > 12)), "******** Off-peak duration cannot last more than 12 hours. Please check your config.h ! ********");
+static_assert(forceSchedule.check_settings(NO_OF_DUMPLOADS), "******** Invalid force window in forceSchedule. Please check your config.h ! ********");
 
 static_assert(!EMONESP_CONTROL || (DIVERSION_PIN_PRESENT && DIVERSION_PIN_PRESENT && (PRIORITY_ROTATION == RotationModes::PIN) && OVERRIDE_PIN_PRESENT), "******** Wrong configuration. Please check your config.h ! ********");
 
 static_assert(!RELAY_DIVERSION | (60 / DATALOG_PERIOD_IN_SECONDS * DATALOG_PERIOD_IN_SECONDS == 60), "******** Wrong configuration. DATALOG_PERIOD_IN_SECONDS must be a divider of 60 ! ********");
 
+constexpr bool check_loadTemperatureLimits()
+{
+  for (const auto &loadLimit : loadTemperatureLimits)
+  {
+    if (loadLimit.sensor != 0xff && (!TEMP_SENSOR_PRESENT || loadLimit.sensor >= temperatureSensing.get_size()))
+      return false;
+  }
+  return true;
+}
+
+static_assert(check_loadTemperatureLimits(), "******** Wrong sensor index for a load temperature limit. Please check your config.h ! ********");
+
+static_assert(ROM_TABLE_EEPROM_ADDRESS + 8 * 8 + 3 <= SETTINGS_EEPROM_ADDRESS, "******** The settings overlap the ROM table in EEPROM ! ********");
+static_assert(ENERGY_EEPROM_END <= E2END + 1, "******** The settings and the energy counters don't fit in EEPROM ! ********");
+
+constexpr bool check_loadEnergyTargets()
+{
+  for (const auto &loadTarget : loadEnergyTargets)
+  {
+    if (loadTarget.target_Wh && (!DUAL_TARIFF || !loadTarget.ratedPower_W))
+      return false;
+  }
+  return true;
+}
+
+static_assert(check_loadEnergyTargets(), "******** Energy targets need dual tariff and the rated power of the load. Please check your config.h ! ********");
+
 constexpr uint16_t check_pins()
 {
   uint32_t used_pins{ 0 };
@@ -83,6 +121,14 @@ constexpr uint16_t check_pins()
     bit_set(used_pins, watchDogPin);
   }
 
+  if (oledPagePin != 0xff)
+  {
+    if (bit_read(used_pins, oledPagePin))
+      return 0;
+
+    bit_set(used_pins, oledPagePin);
+  }
+
   //physicalLoadPin for the TRIACS
   for (const auto &loadPin : physicalLoadPin)
   {
@@ -206,7 +252,8 @@ static_assert(check_load_priorities(), "******** Load Priorities wrong ! Please
 static_assert(check_pins(), "******** Duplicate pin definition ! Please check your config ! ********");
 static_assert((check_pins() & B00000011) == 0, "******** Pins 0 & 1 are reserved for RX/TX ! Please check your config ! ********");
 //static_assert((check_pins() & 0xC000) == 0, "******** Pins 14 and/or 15 do not exist ! Please check your config ! ********");
-//static_assert(!(RF_CHIP_PRESENT && ((check_pins() & 0x3C04) != 0)), "******** Pins from RF chip are reserved ! Please check your config ! ********");
+static_assert(!(RF_CHIP_PRESENT && ((check_pins() & 0x3C04) != 0)), "******** Pins from RF chip are reserved ! Please check your config ! ********");
+static_assert(!RF_CHIP_PRESENT | (RF_SEND_TIMEOUT_MS < DATALOG_PERIOD_IN_SECONDS * 1000UL), "******** RF timeout must be shorter than the datalog period ! ********");
 static_assert(check_relay_pins(), "******** Wrong pin(s) configuration for relay(s) ********");
 
 #endif /* VALIDATION_H */